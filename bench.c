@@ -0,0 +1,319 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * dwmbench drives a running dwm through XTest with the default key and
+ * button bindings of config.def.h and reports the wall-clock latency of
+ * each scenario as one JSON object per line on stdout. A sample ends when
+ * dwm's reaction becomes visible to an X client: a map, a change of
+ * _NET_ACTIVE_WINDOW or a geometry change of a managed window.
+ *
+ * usage: dwmbench [-n windows] [-r rounds]
+ */
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#define TIMEOUTMS 1000
+
+typedef int (*Match)(XEvent *ev);
+
+typedef struct {
+	const char *name;
+	double *v;     /* latency samples in microseconds */
+	int n, timeouts;
+} Series;
+
+static Display *dpy;
+static Window root, overlay;
+static Window *wins;
+static int nwins;
+static int sw, sh;
+static Atom netactive;
+static int rounds = 100;
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "dwmbench: %s\n", msg);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+isourwin(Window w)
+{
+	int i;
+
+	for (i = 0; i < nwins; i++)
+		if (wins[i] == w)
+			return 1;
+	return 0;
+}
+
+static int
+activechanged(XEvent *ev)
+{
+	return ev->type == PropertyNotify && ev->xproperty.window == root
+		&& ev->xproperty.atom == netactive;
+}
+
+static int
+clientmoved(XEvent *ev)
+{
+	return ev->type == ConfigureNotify && isourwin(ev->xconfigure.window);
+}
+
+static int
+overlaymapped(XEvent *ev)
+{
+	if (ev->type != MapNotify || ev->xmap.event != root || isourwin(ev->xmap.window))
+		return 0;
+	overlay = ev->xmap.window;
+	return 1;
+}
+
+static int
+overlaygone(XEvent *ev)
+{
+	return (ev->type == UnmapNotify && ev->xunmap.window == overlay)
+		|| (ev->type == DestroyNotify && ev->xdestroywindow.window == overlay);
+}
+
+static int
+lastmapped(XEvent *ev)
+{
+	return ev->type == MapNotify && ev->xmap.window == wins[nwins - 1];
+}
+
+/* wait for the first event accepted by match; returns 0 on timeout */
+static int
+waitfor(Match match)
+{
+	struct pollfd pfd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+	double deadline = now() + TIMEOUTMS * 1e3;
+	XEvent ev;
+
+	XFlush(dpy);
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (match(&ev))
+				return 1;
+		}
+		if (now() >= deadline || poll(&pfd, 1, (deadline - now()) / 1e3 + 1) <= 0)
+			return 0;
+	}
+}
+
+/* drop whatever the previous step left in the queue */
+static void
+settle(void)
+{
+	XEvent ev;
+
+	XSync(dpy, False);
+	usleep(5000);
+	while (XPending(dpy))
+		XNextEvent(dpy, &ev);
+}
+
+static void
+key(KeySym mod, KeySym ks)
+{
+	KeyCode mc = mod ? XKeysymToKeycode(dpy, mod) : 0, kc = XKeysymToKeycode(dpy, ks);
+
+	if (mc)
+		XTestFakeKeyEvent(dpy, mc, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, kc, True, CurrentTime);
+	XTestFakeKeyEvent(dpy, kc, False, CurrentTime);
+	if (mc)
+		XTestFakeKeyEvent(dpy, mc, False, CurrentTime);
+}
+
+static void
+button(int x, int y, unsigned int b)
+{
+	XTestFakeMotionEvent(dpy, -1, x, y, CurrentTime);
+	XTestFakeButtonEvent(dpy, b, True, CurrentTime);
+	XTestFakeButtonEvent(dpy, b, False, CurrentTime);
+}
+
+static void
+newseries(Series *s, const char *name, int max)
+{
+	s->name = name;
+	s->n = s->timeouts = 0;
+	if (!(s->v = calloc(max, sizeof *s->v)))
+		die("out of memory");
+}
+
+static void
+sample(Series *s, double start, int ok)
+{
+	if (ok)
+		s->v[s->n++] = now() - start;
+	else
+		s->timeouts++;
+}
+
+static int
+cmpdouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+report(Series *s)
+{
+	double p50 = 0, p99 = 0, max = 0;
+
+	if (s->n) {
+		qsort(s->v, s->n, sizeof *s->v, cmpdouble);
+		p50 = s->v[(s->n - 1) / 2];
+		p99 = s->v[(s->n * 99 + 99) / 100 - 1];
+		max = s->v[s->n - 1];
+	}
+	printf("{\"scenario\":\"%s\",\"windows\":%d,\"samples\":%d,\"timeouts\":%d,"
+		"\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+		s->name, nwins, s->n, s->timeouts, p50, p99, max);
+	fflush(stdout);
+	free(s->v);
+	settle();
+}
+
+static void
+waitforwm(void)
+{
+	Atom check = XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False), type;
+	unsigned long n, after;
+	unsigned char *p;
+	int i, format;
+
+	for (i = 0; i < 100; i++) {
+		p = NULL;
+		if (XGetWindowProperty(dpy, root, check, 0, 1, False, XA_WINDOW,
+		                       &type, &format, &n, &after, &p) == Success && p) {
+			XFree(p);
+			if (n)
+				return;
+		}
+		usleep(50000);
+	}
+	die("no window manager on the display");
+}
+
+int
+main(int argc, char *argv[])
+{
+	int i, n = 20, ev, err, maj, min;
+	Series s, s2;
+	double t;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			n = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+			rounds = atoi(argv[++i]);
+		else
+			die("usage: dwmbench [-n windows] [-r rounds]");
+	}
+	if (n < 2 || rounds < 1)
+		die("need at least 2 windows and 1 round");
+	for (i = 0; i < 100 && !(dpy = XOpenDisplay(NULL)); i++)
+		usleep(50000);
+	if (!dpy)
+		die("cannot open display");
+	if (!XTestQueryExtension(dpy, &ev, &err, &maj, &min))
+		die("XTest extension missing");
+	root = DefaultRootWindow(dpy);
+	sw = DisplayWidth(dpy, DefaultScreen(dpy));
+	sh = DisplayHeight(dpy, DefaultScreen(dpy));
+	netactive = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+	waitforwm();
+	XSelectInput(dpy, root, PropertyChangeMask | SubstructureNotifyMask);
+	if (!(wins = calloc(n, sizeof *wins)))
+		die("out of memory");
+
+	/* MapRequest to MapNotify; full height keeps the windows tiled */
+	newseries(&s, "map", n);
+	for (i = 0; i < n; i++) {
+		char name[32];
+
+		wins[i] = XCreateSimpleWindow(dpy, root, 0, 0, sw / 3, sh, 0, 0, 0);
+		snprintf(name, sizeof name, "dwmbench %d", i);
+		XStoreName(dpy, wins[i], name);
+		XSelectInput(dpy, wins[i], StructureNotifyMask);
+		nwins = i + 1;
+		t = now();
+		XMapWindow(dpy, wins[i]);
+		sample(&s, t, waitfor(lastmapped));
+	}
+	report(&s);
+
+	newseries(&s, "focusstep", rounds);
+	for (i = 0; i < rounds; i++) {
+		settle();
+		t = now();
+		key(XK_Alt_L, XK_j);
+		sample(&s, t, waitfor(activechanged));
+	}
+	report(&s);
+
+	/* tag 2 is empty, so both directions change _NET_ACTIVE_WINDOW */
+	newseries(&s, "view", rounds);
+	for (i = 0; i < rounds; i++) {
+		settle();
+		t = now();
+		key(XK_Alt_L, i % 2 ? XK_1 : XK_2);
+		sample(&s, t, waitfor(activechanged));
+	}
+	key(XK_Alt_L, XK_1);
+	report(&s);
+
+	/* the wheel over the tab area of the bar pans the strip */
+	newseries(&s, "scrollmove", rounds);
+	for (i = 0; i < rounds; i++) {
+		settle();
+		t = now();
+		button(sw / 2, 1, (i / 4) % 2 ? Button4 : Button5);
+		sample(&s, t, waitfor(clientmoved));
+	}
+	report(&s);
+
+	newseries(&s, "preview_open", rounds);
+	newseries(&s2, "preview_close", rounds);
+	for (i = 0; i < rounds; i++) {
+		settle();
+		t = now();
+		key(XK_Alt_L, XK_r);
+		sample(&s, t, waitfor(overlaymapped));
+		settle();
+		t = now();
+		key(0, XK_Escape);
+		sample(&s2, t, waitfor(overlaygone));
+	}
+	report(&s);
+	report(&s2);
+
+	for (i = 0; i < n; i++)
+		XDestroyWindow(dpy, wins[i]);
+	XCloseDisplay(dpy);
+	return 0;
+}
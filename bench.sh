@@ -0,0 +1,25 @@
+#!/bin/sh
+# headless benchmark: run ./dwm on Xvfb and drive it with ./dwmbench.
+# Results are JSON lines on stdout; dwm's own latency histograms
+# (SIGUSR1) follow on stderr.
+#
+# environment: BENCHDISPLAY (default :99), BENCHSCREEN (default 1920x1080x24),
+#              BENCHWINDOWS (default 20), BENCHROUNDS (default 100)
+
+display=${BENCHDISPLAY:-:99}
+home=$(mktemp -d) || exit 1
+
+Xvfb "$display" -screen 0 "${BENCHSCREEN:-1920x1080x24}" -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+trap 'kill $dwm $xvfb 2>/dev/null; rm -rf "$home"' EXIT INT TERM
+
+# a private HOME keeps the user's autostart script out of the measurement
+sleep 1
+DISPLAY=$display HOME=$home ./dwm &
+dwm=$!
+
+DISPLAY=$display ./dwmbench -n "${BENCHWINDOWS:-20}" -r "${BENCHROUNDS:-100}"
+status=$?
+kill -USR1 $dwm
+sleep 1
+exit $status
@@ -79,6 +79,10 @@ static const CornerRule cornerrules[] = {
 /* layout(s) */
 static const int resizehints    = 1;    /* 1 means respect size hints in tiled resizals */
 static const int refreshrate    = 120;  /* refresh rate (per second) for client move/resize */
+static const int batchevents    = 1;    /* 1 means drain queued events and relayout/redraw once per batch */
+static const int cullmargin     = 200;  /* scroll layout: clients further off screen than this are parked, not moved, on pans */
+static const float scrollspring = 30.0f; /* scroll layout: pan easing stiffness (1/s), one frame per refreshrate; 0 jumps */
+static const int smoothscrollpx = 100; /* bar titles: px panned per wheel click worth of XInput2 smooth scrolling */
 static const float mfactdefault = 0.7; /* factor of master area size [0.05..0.95] */
 static const float autofloatthreshold = 0.7; /* auto-float threshold for window height as fraction of monitor height */
 
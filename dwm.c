@@ -33,28 +33,68 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <fnmatch.h>
-#include <pthread.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <sys/time.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/sysinfo.h>
 #include <sys/wait.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/sync.h>
+#include <X11/extensions/XInput2.h>
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xproto.h>
 #include <X11/Xutil.h>
+#include <X11/Xlib-xcb.h>
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XSTATS
+#include <X11/Xlibint.h>
+#endif /* XSTATS */
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
+#include "layout.h"
 #include "util.h"
+#include "winindex.h"
+
+#ifdef XSTATS
+/* count the Xlib calls that block on a reply from the server */
+#define ROUNDTRIP(call)         (xroundtrips++, (call))
+#define XSync(...)              ROUNDTRIP((xsyncs++, XSync(__VA_ARGS__)))
+#define XFetchName(...)         ROUNDTRIP(XFetchName(__VA_ARGS__))
+#define XGetClassHint(...)      ROUNDTRIP(XGetClassHint(__VA_ARGS__))
+#define XGetImage(...)          ROUNDTRIP(XGetImage(__VA_ARGS__))
+#define XGetKeyboardMapping(...) ROUNDTRIP(XGetKeyboardMapping(__VA_ARGS__))
+#define XGetModifierMapping(...) ROUNDTRIP(XGetModifierMapping(__VA_ARGS__))
+#define XGetSelectionOwner(...) ROUNDTRIP(XGetSelectionOwner(__VA_ARGS__))
+#define XGetTextProperty(...)   ROUNDTRIP(XGetTextProperty(__VA_ARGS__))
+#define XGetTransientForHint(...) ROUNDTRIP(XGetTransientForHint(__VA_ARGS__))
+#define XGetWindowAttributes(...) ROUNDTRIP(XGetWindowAttributes(__VA_ARGS__))
+#define XGetWindowProperty(...) ROUNDTRIP(XGetWindowProperty(__VA_ARGS__))
+#define XGetWMHints(...)        ROUNDTRIP(XGetWMHints(__VA_ARGS__))
+#define XGetWMNormalHints(...)  ROUNDTRIP(XGetWMNormalHints(__VA_ARGS__))
+#define XGetWMProtocols(...)    ROUNDTRIP(XGetWMProtocols(__VA_ARGS__))
+#define XGrabKeyboard(...)      ROUNDTRIP(XGrabKeyboard(__VA_ARGS__))
+#define XGrabPointer(...)       ROUNDTRIP(XGrabPointer(__VA_ARGS__))
+#define XQueryPointer(...)      ROUNDTRIP(XQueryPointer(__VA_ARGS__))
+#define XQueryTree(...)         ROUNDTRIP(XQueryTree(__VA_ARGS__))
+#define XSyncQueryCounter(...)  ROUNDTRIP(XSyncQueryCounter(__VA_ARGS__))
+#define XIQueryDevice(...)      ROUNDTRIP(XIQueryDevice(__VA_ARGS__))
+#define STATBEGIN()             XStat stat_ = xstatnow()
+#define STATEND(id)             xstatadd((id), &stat_)
+#else
+#define XSync(...)              (xsyncs++, XSync(__VA_ARGS__))
+#define STATBEGIN()
+#define STATEND(id)
+#endif /* XSTATS */
 
 /* macros */
 #define BUTTONMASK              (ButtonPressMask|ButtonReleaseMask)
@@ -65,6 +105,11 @@
 
 #define TEXTW(X)                (drw_fontset_getwidth(drw, (X)) + lrpad)
 #define TEXTWSTATUS(X)          (drw_fontset_getwidth(statusdrw, (X)) + lrpad)
+#define ABS(X)                  ((X) < 0 ? -(X) : (X))
+#define STRIPSIZE               32767 /* strip windows span the whole 16-bit coordinate range */
+#define STRIPX(C)               ((C)->stripx - (C)->mon->scrolls[(C)->tagindex].origin) /* x on the wire */
+#define SYNCTIMEOUT             1000000000ULL /* ns a client gets to answer _NET_WM_SYNC_REQUEST */
+#define INSTRIP(X)              ((X) >= -STRIPSIZE && (X) <= STRIPSIZE)
 #define ISVISIBLE(C)            ((C) && (C)->mon && (C)->mon->scrollindex && (C)->tagindex >= 0 && (C)->tagindex < LENGTH(tags) && (C)->mon->scrollindex == &(C)->mon->scrolls[(C)->tagindex])
 
 #define SYSTEM_TRAY_REQUEST_DOCK    0
@@ -89,9 +134,15 @@ enum { SchemeNorm, SchemeSel, SchemeFG, SchemeBlue, SchemeGreen, SchemeOrange, S
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetSystemTray, NetSystemTrayOP, NetSystemTrayOrientation, NetSystemTrayOrientationHorz,
        NetWMFullscreen, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetWMWindowTypeDesktop, NetClientList, NetLast }; /* EWMH atoms */
+       NetWMWindowTypeDialog, NetWMWindowTypeDesktop, NetClientList,
+       NetWMSyncRequest, NetWMSyncRequestCounter, NetLast }; /* EWMH atoms */
 enum { Manager, Xembed, XembedInfo, XRootPmap, XSetRoot, XLast }; /* Xembed/root atoms */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
+/* window index kinds: WinEntry.p is a Client * for WinClient, WinSystrayIcon
+ * and WinSyncAlarm, a Monitor * otherwise */
+enum { WinClient, WinSystrayIcon, WinBar, WinContainer, WinStrip, WinSyncAlarm };
+enum { DirtyLayout = 1 << 0, DirtyStack = 1 << 1, DirtyBar = 1 << 2,
+       DirtyNotify = 1 << 3, DirtyPan = 1 << 4 }; /* deferred passes */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle, ClkNullWinTitle,
        ClkWinClass, ClkSuperIcon, ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
 
@@ -140,10 +191,23 @@ struct Client {
 	int basew, baseh, incw, inch, maxw, maxh, minw, minh, hintsvalid;
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
 	int ignoreunmap;
+	int parked; /* culled by scroll(): the window sits off screen, x/y/w/h are where it would be */
+	int stripx; /* x in the tag's strip as last sent to the server, virtual: see Scroll.origin */
+	int index, rank; /* position in its Scroll's index, tiled clients before it */
+	Rect srv; /* geometry the server has, in its parent: from our configures and ConfigureNotify */
+	unsigned long srvserial; /* request that last set srv, older notifies are stale */
+	Rect told; /* root geometry in our last synthetic ConfigureNotify, w 0 once a real one followed */
+	Visual *visual;
+	int radius; /* corner radius from cornerrules, -1 until looked up again */
+	/* _NET_WM_SYNC_REQUEST: one resize in flight, the latest held back */
+	XSyncCounter synccounter; /* None if the client does not take part */
+	XSyncAlarm syncalarm;
+	uint64_t syncvalue, syncsent; /* last value asked for, nowns() it was asked, 0 when answered */
+	int syncpending;
 	float mfact;
 	int tagindex;
-	Client *next; /* next pointer for scroll layout linked lists */
-	Client *snext;
+	Client *next, *prev;   /* scroll list of its tag; both NULL when detached, unless it is the only one */
+	Client *snext, *sprev; /* focus stack */
 	Monitor *mon;
 	Window win;
 };
@@ -163,8 +227,28 @@ typedef struct {
 typedef struct Scroll Scroll;
 
 struct Scroll {
-	Client *head;
+	Client *head, *tail;
 	int x;
+	Window strip; /* holds the tag's clients at fixed positions; panning moves only it */
+	int stripx;   /* x the strip was last moved for */
+	/* strip x 0 on the wire is virtual x origin; X coordinates are 16 bit,
+	 * so scroll() recentres it whenever the viewport nears an edge */
+	int origin;
+	/* kinetic pan: x eases toward target, animx is the x the last frame set */
+	int target, animx, animating;
+	float pos, vel;
+	/* gen counts changes to the clients' layout inputs; scroll() records it
+	 * with the area and offset it laid out for, and while all three still
+	 * match, the windows in the strip (geometry and stacking) are current */
+	unsigned int gen, snapgen;
+	Rect snaparea;
+	int snapx;
+	/* index of head as of the last layout: list order, tiled clients with
+	 * the strip x each starts at (prefix sums, one extra for the end) and
+	 * floating ones; indexed is cleared when the list itself changes */
+	Client **all, **tiled, **floating;
+	int *tiledx;
+	int nall, ntiled, nfloating, cap, indexed;
 };
 
 struct Monitor {
@@ -185,8 +269,11 @@ struct Monitor {
 	const Layout *lt[2];
 	Scroll *scrolls;
 	Scroll *scrollindex;
+	Scroll *shown; /* tag whose strip is mapped */
 	int prevtag; /* 上次使用的tag索引 */
 	int logotitlew; /* logotitle的实际宽度 */
+	unsigned int dirty; /* Dirty* passes deferred to the end of the event batch */
+	float pendingpan; /* px of smooth scroll over the bar titles not applied yet */
 };
 
 
@@ -255,8 +342,74 @@ typedef struct {
 	int h;
 } MonitorArea;
 
+/* properties read when a window is managed: all requests go out before
+ * the first reply is waited on, so they cost a single round trip */
+enum { PropNetName, PropName, PropTrans, PropClass, PropState, PropType,
+       PropNormalHints, PropHints, PropProtocols, PropSyncCounter, PropLast };
+
+typedef struct {
+	xcb_get_property_cookie_t ck[PropLast];
+	char name[256];     /* _NET_WM_NAME, else WM_NAME */
+	char wmname[256];   /* WM_NAME, as used by cornerrules */
+	char class[256], instance[256];
+	int hasclass, hassize, haswmh;
+	Window trans;
+	Atom state, wtype;
+	XSizeHints size;
+	XWMHints wmh;
+	XSyncCounter synccounter; /* only if WM_PROTOCOLS lists _NET_WM_SYNC_REQUEST */
+} WinProps;
+
+/* event recording (dwm -R) and replay (dwm -P/-F): a file is a magic line
+ * followed by records of { u8 kind, u32 usecs since previous, u16 len, data } */
+#define RECMAGIC "DWMREC2\n"
+#define RECATOM  (1UL << 30) /* keeps atom ids apart from window ids */
+enum { RecEvent, RecModal, RecFlush, RecWindow, RecAtom, RecPan }; /* record kinds */
+enum { RecWinOther, RecWinRoot, RecWinBorder, RecWinSystray, RecWinBar,
+       RecWinContainer, RecWinStrip }; /* how a recorded window is found again */
+
+typedef struct {
+	uint64_t id;
+	int32_t kind, mon, tag; /* tag only for RecWinStrip */
+	int32_t x, y, w, h, override;
+	/* followed by WM_NAME, instance and class, each NUL-terminated */
+} RecWin;
+
+/* XI2 events are not recorded, their valuators mean nothing on another
+ * server; the bar title pan they caused is */
+typedef struct {
+	uint64_t win;
+	int32_t x;
+	double clicks;
+} RecPanRec;
+
+typedef struct {
+	unsigned long from, to;
+} IdPair;
+
+/* latency histogram: bucket i counts samples in [2^i, 2^(i+1)) ns */
+typedef struct {
+	unsigned long count;
+	unsigned long bucket[64];
+	uint64_t max;
+} Hist;
+
+#ifdef XSTATS
+/* X traffic counters: one slot per event type, then the named passes */
+enum { StatArrange = LASTEvent, StatRestack, StatDrawbar, StatSystray,
+       StatPreview, StatFlush, StatIdleArrange, StatLast };
+
+typedef struct {
+	unsigned long calls;
+	unsigned long requests;   /* requests sent */
+	unsigned long roundtrips; /* calls that waited for a reply */
+	unsigned long bytes;      /* bytes flushed to the server */
+	unsigned long configures; /* client windows moved or resized */
+} XStat;
+#endif /* XSTATS */
+
 /* function declarations */
-static void applyrules(Client *c);
+static void applyrules(Client *c, const char *class, const char *instance);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
@@ -267,8 +420,10 @@ static void buttonpress(XEvent *e);
 static void checkotherwm(void);
 static void cleanup(void);
 static void cleanupmon(Monitor *mon);
+static void collectprops(WinProps *p);
 static void clientmessage(XEvent *e);
 static void configure(Client *c);
+static void configurestale(Client *c);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
@@ -277,8 +432,25 @@ static void detach(Client *c);
 static void detachstack(Client *c);
 static void drawbar(Monitor *m);
 static void drawbars(void);
+static void histadd(Hist *h, uint64_t ns);
+static uint64_t histpct(const Hist *h, unsigned int pct);
+static void histprint(const char *name, const Hist *h);
+static void histpend(Hist *h, uint64_t t);
+static void histprintkeys(const Hist *kh);
+static uint64_t nowns(void);
+static void dumpstats(void);
+static void eventxids(XEvent *ev, void (*win)(Window *), void (*atom)(Atom *));
+static void flushbatch(void);
+static void handleevent(XEvent *ev);
+static void recordevent(XEvent *ev, int kind);
+static void recordpan(Window w, int x, double clicks);
+static void recordopen(const char *path);
+static void recordclients(void);
+static void replay(const char *path, int fast);
 static void enternotify(XEvent *e);
 static void expose(XEvent *e);
+static void flushdirty(void);
+static int pausebatch(void);
 static void ensureclientvisible(Client *c, int minw, int minh);
 static void focus(Client *c);
 static void focusin(XEvent *e);
@@ -291,6 +463,7 @@ static int getrootptr(int *x, int *y);
 static long getstate(Window w);
 static unsigned int getsystraywidth(void);
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
+static void textproptostr(XTextProperty *name, char *text, unsigned int size);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
 
@@ -309,6 +482,7 @@ static void propertynotify(XEvent *e);
 static void quit(const Arg *arg);
 static Monitor *recttomon(int x, int y, int w, int h);
 static void removesystrayicon(Client *i);
+static void requestprops(Window w, WinProps *p);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
 static void resizebarwin(Monitor *m);
 static void resizeclient(Client *c, int x, int y, int w, int h);
@@ -326,6 +500,9 @@ static void setfullscreen(Client *c, int fullscreen);
 static void setlayout(const Arg *arg);
 static void setmfact(const Arg *arg);
 static void scrollmove(const Arg *arg);
+static void scrollby(Monitor *m, int dx);
+static void animatescroll(uint64_t frames);
+static void armanim(int on);
 
 static void setup(void);
 static void seturgent(Client *c, int urg);
@@ -333,6 +510,7 @@ static void setcontainertitle(Monitor *m);
 static int clampcornerradius(int r, int w, int h);
 static void clearwindowshape(Window win);
 static int setwindowrounded(Window win, int w, int h, int r);
+static int cornerradiusfor(const char *class, const char *instance, const char *title, int override_redirect);
 static void applyroundedcorners(Window win);
 static void setroundedfromattrs(Window win, XWindowAttributes *wa);
 static void drawroundedmask(Pixmap mask, GC gc, int x, int y, int w, int h, int r, int val);
@@ -345,6 +523,9 @@ static XImage *getwindowximage_safe(Client *c);
 static XImage *create_placeholder_image(unsigned int w, unsigned int h);
 static XImage *scaleimage(XImage *src, unsigned int nw, unsigned int nh);
 static void showhide(Monitor *m);
+static void showstrip(Monitor *m);
+static int snapshotvalid(Monitor *m);
+static void syncarrange(Monitor *m);
 static void spawn(const Arg *arg);
 static Monitor *systraytomon(Monitor *m);
 static void tag(const Arg *arg);
@@ -363,14 +544,21 @@ static MonitorArea *buildmonitorareas(int *targetcount);
 static void movelastmonclients(Monitor *src, Monitor *dst, int *dirty);
 static void updatenumlockmask(void);
 static void updatesizehints(Client *c);
+static void setsizehints(Client *c, XSizeHints *size);
 static void updatestatus(void);
 static void updatesystray(void);
 static void updatesystrayicongeom(Client *i, int w, int h);
 static void updatesystrayiconstate(Client *i, XPropertyEvent *ev);
 static void updatetitle(Client *c);
 static void updatewindowtype(Client *c);
+static void setwindowtype(Client *c, Atom state, Atom wtype);
 static void updatewmhints(Client *c);
+static void setwmhints(Client *c, XWMHints *wmh);
 static void view(const Arg *arg);
+#ifdef XSTATS
+static XStat xstatnow(void);
+static void xstatadd(int id, XStat *start);
+#endif /* XSTATS */
 static void viewlast(const Arg *arg);
 static void setdefaultfont(void);
 static void setsmallfont(void);
@@ -386,9 +574,35 @@ static void drawlayout(Monitor *m, int *x);
 static void drawclienttabs(Monitor *m, int x, int w, int n);
 static void togglesupericon(const Arg *arg);
 
+static void placeclient(Client *c, int x, int y, int w, int h);
+static void reparentstrip(Client *c);
+static void parkclient(Client *c);
+static void setshadow(Client *c, int x, int y, int w, int h);
+static void movewin(Client *c, int x, int y);
+static void indexstrip(Scroll *s);
+static Scroll *stripindex(Monitor *m);
+static int tiledat(Scroll *s, int px);
+static void configurestrip(Monitor *m);
+static Rect *layoutstrip(Monitor *m);
+static void revealnew(Client *c);
 static void scroll(Monitor *m);
 static void scrollmoveothers(const Arg *arg);
 static void initshape(void);
+static void initsync(void);
+static void initxi(void);
+static void xiscan(void);
+static void xiseed(int deviceid);
+static void xiseedfrom(XIDeviceInfo *info, int n);
+static void genericevent(XEvent *e);
+static void ximotion(XIDeviceEvent *ev);
+static void xipan(Window w, int x, double clicks);
+static void applypan(Monitor *m);
+static unsigned int barclick(Monitor *m, int px, Arg *arg);
+static void syncrequest(Client *c);
+static void syncdone(Client *c);
+static void syncexpire(void);
+static void syncalarmnotify(XEvent *e);
+static uint64_t syncint(XSyncValue v);
 static void initcompositor(void);
 static void redirectmonitor(Monitor *m);
 
@@ -422,8 +636,8 @@ static void handleStatus4(const Arg *arg);
 static void handleStatus5(const Arg *arg);
 static int gettempnums(void);
 static void initstatusbar(void);
-static void *drawstatusbar(void *arg);
-static void cleanstatuspthread(void);
+static void drawstatusbar(void);
+static void cleanstatusbar(void);
 static void updatestatuscache(void);
 static void freestatuscache(void);
 static void handlestatusclick(const Arg *arg, int button);
@@ -453,10 +667,6 @@ static int (*xerrorxlib)(Display *, XErrorEvent *);
 static unsigned int numlockmask = 0;
 
 /* status bar global variables */
-static pthread_t drawstatusthread;
-static int status_thread_started = 0;
-static int status_thread_running = 0;
-static pthread_mutex_t statuscache_mutex = PTHREAD_MUTEX_INITIALIZER;
 static Node Nodes[NODE_NUM];
 static int numCores;
 static int thermalzoneindex = 0;
@@ -478,6 +688,7 @@ static Block Blocks[] = {
 };
 static void (*handler[LASTEvent]) (XEvent *) = {
 	[ButtonPress] = buttonpress,
+	[GenericEvent] = genericevent,
 	[ClientMessage] = clientmessage,
 	[ConfigureRequest] = configurerequest,
 	[ConfigureNotify] = configurenotify,
@@ -496,6 +707,46 @@ static void (*handler[LASTEvent]) (XEvent *) = {
 };
 static Atom wmatom[WMLast], netatom[NetLast], xatom[XLast];
 static int running = 1;
+static int epfd = -1;      /* main loop: X connection, timerfd and signalfd */
+static int timerfd = -1;   /* periodic tick driving the status bar */
+static int animfd = -1;    /* frame tick at refreshrate, armed while a pan animates */
+static int sigfd = -1;     /* SIGCHLD and SIGUSR1 delivery */
+static int batching = 0;   /* handlers only mark Dirty* flags while set */
+static int borderdirty = 0;
+static unsigned long enterserial; /* EnterNotify before this request came from our own restack */
+static unsigned long xsyncs;      /* XSync calls, reported per second by dumpstats */
+static uint64_t startns;
+#ifdef XSTATS
+static XStat xstats[StatLast];
+static unsigned long xroundtrips, xbytes, xconfigures;
+static const char *xstatnames[] = {
+	"arrange", "restack", "drawbar", "updatesystray", "previewscroll", "flushdirty",
+	"arrange unchanged",
+};
+#endif /* XSTATS */
+static Hist evhist[LASTEvent], flushhist; /* handler and batch latency */
+static FILE *recfp;        /* -R: events are appended here */
+static uint64_t reclast;   /* time of the previous record */
+static IdPair *recids;     /* sorted: ids already described, or replay translations */
+static int nrecids, recidscap;
+static const char *evnames[LASTEvent] = {
+	[ButtonPress] = "ButtonPress",
+	[ClientMessage] = "ClientMessage",
+	[ConfigureRequest] = "ConfigureRequest",
+	[ConfigureNotify] = "ConfigureNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[EnterNotify] = "EnterNotify",
+	[Expose] = "Expose",
+	[FocusIn] = "FocusIn",
+	[KeyPress] = "KeyPress",
+	[MappingNotify] = "MappingNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[MotionNotify] = "MotionNotify",
+	[PropertyNotify] = "PropertyNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[UnmapNotify] = "UnmapNotify",
+};
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
@@ -505,14 +756,24 @@ static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
 static int composite_supported = 0;
 static int shape_supported = 0;
+static int sync_supported = 0, syncevbase, syncerbase;
+static int xiopcode = -1;  /* XInput 2.1 smooth scrolling over the bars, -1 without it */
+static struct {
+	int dev, valuator;   /* slave pointer and its scroll valuator */
+	double increment;    /* valuator change worth one wheel click */
+	double last;         /* previous value, deltas need one */
+	int haslast;
+} xiscroll[16];
+static int nxiscroll;
+static int syncwaits;      /* clients with a sync request unanswered */
 static Window borderwin = None;
+static WinIndex winindex;  /* every window dwm owns or manages */
 
 /* status bar cache */
 static Pixmap statuscache = None;
 static int cachew = 0;
 static int cacheh = 0;
 static int cachevalid = 0;
-static time_t lastupdate = 0;
 
 /* preview mode */
 static int previewmode = PREVIEW_SCROLL;  /* will be initialized from config */
@@ -520,22 +781,24 @@ static int previewmode = PREVIEW_SCROLL;  /* will be initialized from config */
 /* configuration, allows nested code to access above variables */
 #include "config.h"
 
+static Hist keyhist[LENGTH(keys)]; /* latency of each key binding's function */
+/* dispatch to the end of the batch that put the result on the wire: with
+ * batching the handlers above only mark what the flush then does */
+static Hist evdone[LASTEvent], keydone[LENGTH(keys)];
+static struct { Hist *h; uint64_t t; } *pending; /* started, batch not flushed yet */
+static int npending, cappending;
+
 /* function implementations */
 void
-applyrules(Client *c)
+applyrules(Client *c, const char *class, const char *instance)
 {
-	const char *class, *instance;
 	unsigned int i;
 	const Rule *r;
 	Monitor *m;
-	XClassHint ch = { NULL, NULL };
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tagindex = -1;  // 初始化为无效值
-	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
 
 	for (i = 0; i < LENGTH(rules); i++) {
 		r = &rules[i];
@@ -551,10 +814,6 @@ applyrules(Client *c)
 		}
 	}
 
-	if (ch.res_class)
-		XFree(ch.res_class);
-	if (ch.res_name)
-		XFree(ch.res_name);
 	// 如果没有匹配规则，使用当前monitor的scrollindex对应的索引
 	if (c->tagindex == -1) {
 		for (int i = 0; i < LENGTH(tags); i++) {
@@ -576,74 +835,42 @@ applyrules(Client *c)
 int
 applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact)
 {
-	int baseismin;
 	Monitor *m = c->mon;
-
-	/* set minimum possible */
-	*w = MAX(1, *w);
-	*h = MAX(1, *h);
-	if (interact) {
-		if (*x > sw)
-			*x = sw - c->w;
-		if (*y > sh)
-			*y = sh - c->h;
-		if (*x + *w < 0)
-			*x = 0;
-		if (*y + *h < 0)
-			*y = 0;
-	} else {
-		if (*x >= m->wx + m->ww)
-			*x = m->wx + m->ww - c->w;
-		if (*y >= m->wy + m->wh)
-			*y = m->wy + m->wh - c->h;
-		if (*x + *w <= m->wx)
-			*x = m->wx;
-		if (*y + *h <= m->wy)
-			*y = m->wy;
-	}
-	if (*h < bh)
-		*h = bh;
-	if (*w < bh)
-		*w = bh;
-	if (resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
-		if (!c->hintsvalid)
-			updatesizehints(c);
-		/* see last two sentences in ICCCM 4.1.2.3 */
-		baseismin = c->basew == c->minw && c->baseh == c->minh;
-		if (!baseismin) { /* temporarily remove base dimensions */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for aspect limits */
-		if (c->mina > 0 && c->maxa > 0) {
-			if (c->maxa < (float)*w / *h)
-				*w = *h * c->maxa + 0.5;
-			else if (c->mina < (float)*h / *w)
-				*h = *w * c->mina + 0.5;
-		}
-		if (baseismin) { /* increment calculation requires this */
-			*w -= c->basew;
-			*h -= c->baseh;
-		}
-		/* adjust for increment value */
-		if (c->incw)
-			*w -= *w % c->incw;
-		if (c->inch)
-			*h -= *h % c->inch;
-		/* restore base dimensions */
-		*w = MAX(*w + c->basew, c->minw);
-		*h = MAX(*h + c->baseh, c->minh);
-		if (c->maxw)
-			*w = MIN(*w, c->maxw);
-		if (c->maxh)
-			*h = MIN(*h, c->maxh);
-	}
+	Rect r = { *x, *y, *w, *h };
+	Rect bound = interact ? (Rect){ 0, 0, sw, sh } : (Rect){ m->wx, m->wy, m->ww, m->wh };
+	Hints hints;
+	int usehints = resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange;
+
+	if (usehints && !c->hintsvalid)
+		updatesizehints(c);
+	hints = (Hints){ c->basew, c->baseh, c->incw, c->inch, c->maxw, c->maxh,
+	                 c->minw, c->minh, c->mina, c->maxa };
+	layout_sizehints(&r, (Rect){ c->x, c->y, c->w, c->h }, bound, interact, bh,
+		usehints ? &hints : NULL);
+	*x = r.x;
+	*y = r.y;
+	*w = r.w;
+	*h = r.h;
 	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
 }
 
 void
 arrange(Monitor *m)
 {
+	if (batching) {
+		if (m)
+			m->dirty |= DirtyLayout|DirtyStack;
+		else for (m = mons; m; m = m->next)
+			m->dirty |= DirtyLayout;
+		borderdirty = 1;
+		return;
+	}
+	STATBEGIN();
+#ifdef XSTATS
+	/* a strip that still holds its last layout needs no client touched:
+	 * the configures column of this row must stay 0 */
+	int idle = m && snapshotvalid(m);
+#endif /* XSTATS */
 	if (m)
 		showhide(m);
 	else for (m = mons; m; m = m->next)
@@ -654,6 +881,65 @@ arrange(Monitor *m)
 	} else for (m = mons; m; m = m->next)
 		arrangemon(m);
 	updateborderwin();
+#ifdef XSTATS
+	if (idle)
+		STATEND(StatIdleArrange);
+#endif /* XSTATS */
+	STATEND(StatArrange);
+}
+
+/* run the passes handlers deferred while batching, each once per monitor */
+void
+flushdirty(void)
+{
+	Monitor *m;
+	unsigned int d;
+	STATBEGIN();
+
+	for (m = mons; m; m = m->next) {
+		if (!(d = m->dirty))
+			continue;
+		m->dirty = 0;
+		if (d & DirtyPan)
+			applypan(m);
+		if (d & DirtyLayout) {
+			showhide(m);
+			arrangemon(m);
+		}
+		if (d & DirtyStack)
+			restack(m); /* also redraws the bar */
+		else if (d & DirtyBar)
+			drawbar(m);
+		if (d & DirtyNotify)
+			configurestrip(m);
+	}
+	if (borderdirty) {
+		borderdirty = 0;
+		updateborderwin();
+	}
+	STATEND(StatFlush);
+}
+
+/* modal loops draw synchronously: settle deferred work and leave batch mode */
+int
+pausebatch(void)
+{
+	int b = batching;
+
+	batching = 0;
+	flushdirty();
+	return b;
+}
+
+/* apply a deferred layout now, for callers that read the resulting geometry */
+void
+syncarrange(Monitor *m)
+{
+	if (!m || !(m->dirty & DirtyLayout))
+		return;
+	m->dirty &= ~DirtyLayout;
+	showhide(m);
+	arrangemon(m);
 }
 
 void
@@ -669,49 +955,53 @@ arrangemon(Monitor *m)
 void
 attach(Client *c)
 {
-	Client *last;
+	Client *sel;
+	Scroll *s;
 	int i = c->tagindex;
 
 	if (i < 0 || i >= LENGTH(tags) || !c->mon)
 		return;
+	s = &c->mon->scrolls[i];
+	s->indexed = 0;
+	s->gen++;
 	
 	/* Insert after current selection when possible (non-floating preference) */
-	if (!c->isfloating && c->mon->sel && c->mon->sel->tagindex == i) {
-		Client **pp = &c->mon->scrolls[i].head;
-		for (; *pp && *pp != c->mon->sel; pp = &(*pp)->next);
-		if (*pp == c->mon->sel) {
-			c->next = c->mon->sel->next;
-			c->mon->sel->next = c;
-			return;
-		}
+	sel = c->mon->sel;
+	if (!c->isfloating && sel && sel != c && sel->tagindex == i && (sel->prev || s->head == sel)) {
+		c->prev = sel;
+		c->next = sel->next;
+		if (sel->next)
+			sel->next->prev = c;
+		else
+			s->tail = c;
+		sel->next = c;
+		return;
 	}
 
-	/* Find the last client in this tagindex's scroll list */
-	last = NULL;
-	Client *curr;
-	for (curr = c->mon->scrolls[i].head; curr; curr = curr->next)
-		last = curr;
-	
 	/* Append client to the appropriate tagindex list */
-	if (last) {
-		last->next = c;
-	} else {
-		c->mon->scrolls[i].head = c;
-	}
+	c->prev = s->tail;
 	c->next = NULL;
+	if (s->tail)
+		s->tail->next = c;
+	else
+		s->head = c;
+	s->tail = c;
 }
 
 void
 attachstack(Client *c)
 {
+	c->sprev = NULL;
 	c->snext = c->mon->stack;
+	if (c->snext)
+		c->snext->sprev = c;
 	c->mon->stack = c;
 }
 
 void
 buttonpress(XEvent *e)
 {
-	unsigned int i, x, click;
+	unsigned int i, click;
 	Arg arg = {0};
 	Client *c;
 	Monitor *m;
@@ -725,50 +1015,7 @@ buttonpress(XEvent *e)
 		focus(NULL);
 	}
 	if (ev->window == selmon->barwin) {
-		i = 0;
-		x = supericonw + selmon->logotitlew;
-		do
-			x += TEXTW(tags[i]);
-		while (ev->x >= x && ++i < LENGTH(tags));
-		if (ev->x < supericonw) {
-			click = ClkSuperIcon;
-		} else if (ev->x < supericonw + selmon->logotitlew) {
-			click = ClkWinClass;
-		} else if (i < LENGTH(tags)) {
-			click = ClkTagBar;
-			arg.i = i;
-		} else if (ev->x < x + TEXTW(selmon->ltsymbol)) {
-			click = ClkLtSymbol;
-		} else if (ev->x > selmon->ww - systandstat) {
-			click = ClkStatusText;
-			/* 确定点击的是哪个status组件 */
-			int stbsw = 0;
-			int stx = selmon->ww - ev->x - systrayw;
-			for (i = 0; i < LENGTH(Blocks); i++) {
-				stbsw += Blocks[i].bw;
-				if (stbsw > stx) {
-					arg.i = i;
-					break;
-				}
-			}
-		} else {
-			x += TEXTW(selmon->ltsymbol);
-				int n = 0;
-				for (c = m->scrollindex->head; c; c = c->next)
-					n++;
-				if (m->scrollindex->head && n > 0) {
-					c = m->scrollindex->head;
-					int tabw = (selmon->ww - systandstat - x) / n;
-					do {
-						x += tabw;
-					} while (ev->x > x && (c = c->next));
-
-				click = ClkWinTitle;
-				arg.v = c;
-			} else {
-				click = ClkNullWinTitle;
-			}
-		}
+		click = barclick(selmon, ev->x, &arg);
 	} else if ((c = wintoclient(ev->window))) {
 		focus(c);
 		restack(selmon);
@@ -777,11 +1024,62 @@ buttonpress(XEvent *e)
 	}
 	for (i = 0; i < LENGTH(buttons); i++)
 		if (click == buttons[i].click && buttons[i].func && buttons[i].button == ev->button
-		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+		&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state)
+		/* with XI2 the wheel over the titles pans through its valuators */
+		&& !(click == ClkWinTitle && buttons[i].func == scrollmove && nxiscroll))
 			buttons[i].func((click == ClkTagBar || click == ClkWinTitle || click == ClkStatusText) &&
 				buttons[i].arg.i == 0 ? &arg : &buttons[i].arg);
 }
 
+/* which part of m's bar is at x px, with the tag, status block or client in arg */
+unsigned int
+barclick(Monitor *m, int px, Arg *arg)
+{
+	unsigned int i, x, click = ClkRootWin;
+
+	i = 0;
+	x = supericonw + m->logotitlew;
+	do
+		x += TEXTW(tags[i]);
+	while (px >= x && ++i < LENGTH(tags));
+	if (px < supericonw) {
+		click = ClkSuperIcon;
+	} else if (px < supericonw + m->logotitlew) {
+		click = ClkWinClass;
+	} else if (i < LENGTH(tags)) {
+		click = ClkTagBar;
+		arg->i = i;
+	} else if (px < x + TEXTW(m->ltsymbol)) {
+		click = ClkLtSymbol;
+	} else if (px > m->ww - systandstat) {
+		click = ClkStatusText;
+		/* 确定点击的是哪个status组件 */
+		int stbsw = 0;
+		int stx = m->ww - px - systrayw;
+		for (i = 0; i < LENGTH(Blocks); i++) {
+			stbsw += Blocks[i].bw;
+			if (stbsw > stx) {
+				arg->i = i;
+				break;
+			}
+		}
+	} else {
+		x += TEXTW(m->ltsymbol);
+		Scroll *s = stripindex(m);
+		if (s->nall > 0) {
+			/* equal tabs: the one under the pointer is a division away */
+			int tabw = (m->ww - systandstat - (int)x) / s->nall;
+			int k = px > (int)x ? (tabw > 0 ? (px - (int)x - 1) / tabw : s->nall) : 0;
+
+			click = ClkWinTitle;
+			arg->v = k < s->nall ? s->all[k] : NULL;
+		} else {
+			click = ClkNullWinTitle;
+		}
+	}
+	return click;
+}
+
 static void
 ensureclientvisible(Client *c, int minw, int minh)
 {
@@ -792,77 +1090,20 @@ ensureclientvisible(Client *c, int minw, int minh)
 
 	if (m->lt[m->sellt]->arrange != scroll)
 		return;
-
-	if (minw < 1)
-		minw = 1;
-
-	int cw = c->w;
-	if (minw > cw)
-		minw = cw;
-	int ch = c->h;
-	if (minh > ch)
-		minh = ch;
-
-	/* shrink visible band by gaps so checks match layout space */
-	int view_left = m->wx + gappx;
-	int view_right = m->wx + m->ww - gappx;
-	int view_top = m->wy + scrollstartgap + gappx;
-	int view_bottom = m->wy + m->wh - scrollstartgap - gappx;
-	int cleft = c->x;
-	int cright = c->x + cw;
-	int ctop = c->y;
-	int cbottom = c->y + ch;
-
-	int visible_left = cleft > view_left ? cleft : view_left;
-	int visible_right = cright < view_right ? cright : view_right;
-	int visible_top = ctop > view_top ? ctop : view_top;
-	int visible_bottom = cbottom < view_bottom ? cbottom : view_bottom;
-	int visw = visible_right - visible_left;
-	int vish = visible_bottom - visible_top;
-
-	if (visw >= minw && vish >= minh)
+	syncarrange(m);
+
+	/* a running pan is as good as done: reveal from where it is heading */
+	Scroll *s = m->scrollindex;
+	int ahead = s->animating ? s->target - s->x : 0;
+	int dx, dy;
+	if (!layout_reveal((Rect){ c->x - ahead, c->y, c->w, c->h }, (Rect){ m->wx, m->wy, m->ww, m->wh },
+	                   gappx, scrollstartgap, minw, minh, c->isfloating, &dx, &dy))
 		return;
-
-	int delta = 0;
-	if (cleft < view_left) {
-		delta = cleft - view_left;
-	} else if (cleft + minw > view_right) {
-		delta = cleft + minw - view_right;
-	} else if (cright > view_right) {
-		delta = cright - view_right;
-	}
-
-	if (delta != 0) {
-		Arg a = { .i = delta };
-		scrollmove(&a);
-	}
-
-	/* Vertical visibility fix for floating clients */
-	if (vish < minh && c->isfloating) {
-		int shortage = minh - vish;
-		if (ctop < view_top && cbottom <= view_bottom) {
-			int dy = shortage;
-			if (cbottom + dy > view_bottom)
-				dy = view_bottom - cbottom;
-			if (dy > 0)
-				resize(c, c->x, c->y + dy, c->w, c->h, 0);
-		} else if (cbottom > view_bottom && ctop >= view_top) {
-			int dy = shortage;
-			if (ctop - dy < view_top)
-				dy = ctop - view_top;
-			if (dy > 0)
-				resize(c, c->x, c->y - dy, c->w, c->h, 0);
-		} else {
-			/* fallback: clamp to viewport band */
-			int newy = c->y;
-			if (newy < view_top)
-				newy = view_top;
-			if (newy + minh > view_bottom)
-				newy = view_bottom - minh;
-			if (newy != c->y)
-				resize(c, c->x, newy, c->w, c->h, 0);
-		}
-	}
+	if (dx)
+		scrollby(m, dx);
+	/* vertical visibility fix for floating clients */
+	if (dy)
+		resize(c, c->x, c->y + dy, c->w, c->h, 0);
 }
 
 void
@@ -895,33 +1136,24 @@ focusstep(const Arg *arg)
 	if (dir == 0)
 		return;
 
-	Client *head = selmon->scrollindex->head;
+	Scroll *s = stripindex(selmon);
 	Client *sel = selmon->sel;
 	Client *target = NULL;
+	int i;
 
-	if (!head)
+	if (!s->ntiled)
 		return;
+	if (sel && (sel->index >= s->nall || s->all[sel->index] != sel))
+		sel = NULL;
 
+	/* neighbours in the strip are one rank away */
 	if (dir > 0) {
-		Client *start = sel ? sel->next : head;
-			for (Client *it = start; it; it = it->next)
-				if (!it->isfloating) {
-					target = it;
-					break;
-				}
-		} else { /* dir < 0 */
-			Client *prev = NULL;
-			if (sel) {
-				for (Client *it = head; it && it != sel; it = it->next)
-					if (!it->isfloating)
-						prev = it;
-				target = prev;
-			} else {
-				for (Client *it = head; it; it = it->next)
-					if (!it->isfloating)
-						target = it;
-			}
-		}
+		i = sel ? sel->rank + !sel->isfloating : 0;
+		target = i < s->ntiled ? s->tiled[i] : NULL;
+	} else {
+		i = sel ? sel->rank - 1 : s->ntiled - 1;
+		target = i >= 0 ? s->tiled[i] : NULL;
+	}
 
 	if (target && target != selmon->sel) {
 		focus(target);
@@ -1105,13 +1337,10 @@ create_placeholder_image(unsigned int w, unsigned int h)
 static XImage *
 getwindowximage(Client *c)
 {
-	XWindowAttributes attr;
-	if (!c)
-		return NULL;
-	if (!XGetWindowAttributes(dpy, c->win, &attr))
+	if (!c || !c->visual)
 		return NULL;
 
-	XRenderPictFormat *format = XRenderFindVisualFormat(dpy, attr.visual);
+	XRenderPictFormat *format = XRenderFindVisualFormat(dpy, c->visual);
 	if (!format)
 		return NULL;
 	int hasalpha = (format && format->type == PictTypeDirect && format->direct.alphaMask);
@@ -1189,14 +1418,9 @@ getwindowximage_safe(Client *c)
 	/* 设置错误处理器以捕获X错误 */
 	XErrorHandler old = XSetErrorHandler(xerrordummy);
 
-	/* 尝试获取窗口图像 */
-	XWindowAttributes attr;
-	if (XGetWindowAttributes(dpy, c->win, &attr)) {
-		/* 检查窗口属性是否有效 */
-		if (attr.width > 0 && attr.height > 0 && attr.width < 8192 && attr.height < 8192) {
-			res = getwindowximage(c);
-		}
-	}
+	/* 尝试获取窗口图像，尺寸取自几何影子 */
+	if (c->srv.w > 0 && c->srv.h > 0 && c->srv.w < 8192 && c->srv.h < 8192)
+		res = getwindowximage(c);
 
 	/* 恢复原来的错误处理器 */
 	XSetErrorHandler(old);
@@ -1651,108 +1875,18 @@ freepreviewitems(PreviewItem *items, int n)
 static void
 arrangePreviewsGrid(PreviewItem *items, int n, int pad, int previeww, int previewh, int *totalh, int *totalw)
 {
-	if (n == 1) {
-		int sw = items[0].scaled ? items[0].scaled->width : 0;
-		int sh = items[0].scaled ? items[0].scaled->height : 0;
-		items[0].x = (previeww - sw) / 2;
-		items[0].y = (previewh - sh) / 2;
-		if (totalh) *totalh = sh;
-		if (totalw) *totalw = sw;
-		return;
-	}
-
-	if (n <= 4) {
-		unsigned int total_gapi = pad * (n - 1);
-		unsigned int row_width = 0;
-		int maxh = 0;
-		for (int i = 0; i < n; i++) {
-			int sw = items[i].scaled ? items[i].scaled->width : 0;
-			int sh = items[i].scaled ? items[i].scaled->height : 0;
-			row_width += sw;
-			if (sh > maxh) maxh = sh;
-		}
-		row_width += total_gapi;
-
-		int cx = (previeww - row_width) / 2;
-		int cy = (previewh - maxh) / 2;
-
-		for (int i = 0; i < n; i++) {
-			int sw = items[i].scaled ? items[i].scaled->width : 0;
-			int sh = items[i].scaled ? items[i].scaled->height : 0;
-			items[i].x = cx;
-			items[i].y = cy + (maxh - sh) / 2;
-			cx += sw + pad;
-		}
-		if (totalh) *totalh = maxh;
-		if (totalw) *totalw = row_width;
-		return;
-	}
-
-	unsigned int cols, rows;
-	for (cols = 0; cols <= n / 2; cols++)
-		if (cols * cols >= n)
-			break;
-	rows = (cols && (cols - 1) * cols >= n) ? cols - 1 : cols;
-
-	/* 检查宽度约束，确保每行能放入画布 */
-	while (cols > 1) {
-		int estimated_row_width = 0;
-		for (int i = 0; i < cols && i < n; i++) {
-			int sw = items[i].scaled ? items[i].scaled->width : 0;
-			estimated_row_width += sw;
-		}
-		estimated_row_width += (cols - 1) * pad;
-		if (estimated_row_width <= previeww)
-			break;
-		cols--;
-		rows = (n + cols - 1) / cols;
-	}
-
-	int idx = 0;
-	int cy = 0;
-	int maxh = 0;
-	int maxw = 0;
-
-	for (unsigned int i = 0; i < rows; i++) {
-		int cx = 0;
-		int row_maxh = 0;
-		int start_idx = idx;
-
-		for (unsigned int j = 0; j < cols; j++) {
-			if (idx >= n)
-				break;
-			int sw = items[idx].scaled ? items[idx].scaled->width : 0;
-			int sh = items[idx].scaled ? items[idx].scaled->height : 0;
-			items[idx].x = cx;
-			if (sh > row_maxh) row_maxh = sh;
-			if (sw > maxw) maxw = sw;
-			cx += sw + pad;
-			idx++;
-		}
-
-		int row_width = cx - pad;
-		cx = (previeww - row_width) / 2;
-		for (unsigned int j = 0; j < cols && start_idx < n; j++) {
-			items[start_idx].x += cx;
-			items[start_idx].y = cy;
-			start_idx++;
-		}
+	Rect *r = ecalloc(n, sizeof(Rect));
 
-		cy += row_maxh + pad;
-		if (row_maxh > maxh) maxh = row_maxh;
+	for (int i = 0; i < n; i++) {
+		r[i].w = items[i].scaled ? items[i].scaled->width : 0;
+		r[i].h = items[i].scaled ? items[i].scaled->height : 0;
 	}
-
-	if (totalh) *totalh = cy - pad;
-	if (totalw) *totalw = maxw;
-
-	/* 垂直居中 */
-	int total_content_height = cy - pad;
-	if (total_content_height < previewh) {
-		int vertical_offset = (previewh - total_content_height) / 2;
-		for (int i = 0; i < n; i++) {
-			items[i].y += vertical_offset;
-		}
+	layout_grid(r, n, pad, previeww, previewh, totalw, totalh);
+	for (int i = 0; i < n; i++) {
+		items[i].x = r[i].x;
+		items[i].y = r[i].y;
 	}
+	free(r);
 }
 
 static void
@@ -1890,6 +2024,8 @@ previewscroll(const Arg *arg)
 			n++;
 	if (n == 0)
 		return;
+	STATBEGIN();
+	int wasbatching = pausebatch();
 
 	PreviewItem *items = ecalloc(n, sizeof(PreviewItem));
 
@@ -1906,6 +2042,8 @@ previewscroll(const Arg *arg)
 
 	if (minx == INT_MAX || maxr <= minx) {
 		free(items);
+		batching = wasbatching;
+		STATEND(StatPreview);
 		return;
 	}
 
@@ -2097,6 +2235,7 @@ previewscroll(const Arg *arg)
 	while (preview_running) {
 		XEvent ev;
 		XNextEvent(dpy, &ev);
+		recordevent(&ev, RecModal);
 		needblit = 0;
 
 		if (!dispatchpreviewevent(&ev, m, pwin, &buf, &previewmode, &previeww, &previewh,
@@ -2146,6 +2285,8 @@ preview_cleanup:
 		free(items);
 		items = NULL;
 	}
+	batching = wasbatching;
+	STATEND(StatPreview);
 }
 
 void
@@ -2168,7 +2309,7 @@ cleanup(void)
 	size_t i;
 
 	view(&a);
-	cleanstatuspthread();
+	cleanstatusbar();
 	freestatuscache();
 	selmon->lt[selmon->sellt] = &foo;
 	for (m = mons; m; m = m->next)
@@ -2195,6 +2336,14 @@ cleanup(void)
 	XDestroyWindow(dpy, wmcheckwin);
 	drw_free(drw);
 	drw_free(statusdrw);
+	winindexfree(&winindex);
+	close(epfd);
+	close(timerfd);
+	close(animfd);
+	close(sigfd);
+	if (recfp)
+		fclose(recfp);
+	free(recids);
 
 	XSync(dpy, False);
 	XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
@@ -2215,19 +2364,29 @@ cleanupmon(Monitor *mon)
 	}
 	
 	/* 先取消复合重定向，避免子窗口问题 */
-	if (composite_supported && mon->container) {
-		XCompositeUnredirectSubwindows(dpy, mon->container, CompositeRedirectAutomatic);
+	for (int i = 0; i < LENGTH(tags); i++) {
+		if (composite_supported)
+			XCompositeUnredirectSubwindows(dpy, mon->scrolls[i].strip, CompositeRedirectAutomatic);
+		winindexdel(&winindex, mon->scrolls[i].strip);
 	}
 	
+	winindexdel(&winindex, mon->barwin);
 	XUnmapWindow(dpy, mon->barwin);
 	XDestroyWindow(dpy, mon->barwin);
 	
 	/* 确保container窗口存在且有效 */
 	if (mon->container) {
+		winindexdel(&winindex, mon->container);
 		XUnmapWindow(dpy, mon->container);
 		XDestroyWindow(dpy, mon->container);
 	}
 	
+	for (int i = 0; i < LENGTH(tags); i++) {
+		free(mon->scrolls[i].all);
+		free(mon->scrolls[i].tiled);
+		free(mon->scrolls[i].floating);
+		free(mon->scrolls[i].tiledx);
+	}
 	free(mon->scrolls);
 	free(mon);
 }
@@ -2252,6 +2411,7 @@ clientmessage(XEvent *e)
 			c->mon = selmon;
 			c->next = systray->icons;
 			systray->icons = c;
+			winindexadd(&winindex, c->win, WinSystrayIcon, c);
 			if (!XGetWindowAttributes(dpy, c->win, &wa)) {
 				/* use sane defaults */
 				wa.width = bh;
@@ -2277,7 +2437,6 @@ clientmessage(XEvent *e)
 			sendevent(c->win, netatom[Xembed], StructureNotifyMask, CurrentTime, XEMBED_FOCUS_IN, 0 , systray->win, XEMBED_EMBEDDED_VERSION);
 			sendevent(c->win, netatom[Xembed], StructureNotifyMask, CurrentTime, XEMBED_WINDOW_ACTIVATE, 0 , systray->win, XEMBED_EMBEDDED_VERSION);
 			sendevent(c->win, netatom[Xembed], StructureNotifyMask, CurrentTime, XEMBED_MODALITY_ON, 0 , systray->win, XEMBED_EMBEDDED_VERSION);
-			XSync(dpy, False);
 			resizebarwin(selmon);
 			updatesystray();
 			setclientstate(c, NormalState);
@@ -2316,6 +2475,17 @@ configure(Client *c)
 	ce.above = None;
 	ce.override_redirect = False;
 	XSendEvent(dpy, c->win, False, StructureNotifyMask, (XEvent *)&ce);
+	c->told = (Rect){ c->x, c->y, c->w, c->h };
+}
+
+/* ICCCM 4.1.5: a client that was moved but not resized gets only strip
+ * coordinates from the server, its root position comes from us; skip the
+ * event if it already has it */
+void
+configurestale(Client *c)
+{
+	if (c->told.x != c->x || c->told.y != c->y || c->told.w != c->w || c->told.h != c->h)
+		configure(c);
 }
 
 void
@@ -2344,20 +2514,19 @@ configurenotify(XEvent *e)
 			focus(NULL);
 			arrange(NULL);
 		}
+	} else if ((c = wintoclient(ev->window))) {
+		/* our synthetic notifies from configure() carry root
+		 * coordinates, not the strip's */
+		if (ev->send_event)
+			return;
+		/* only a notify for our latest request or later is current */
+		if ((long)(ev->serial - c->srvserial) >= 0)
+			c->srv = (Rect){ ev->x, ev->y, ev->width, ev->height };
 	} else if (shape_supported) {
 		XWindowAttributes wa;
-		int isbar = 0;
-
-		if (ev->window == borderwin || wintoclient(ev->window) || wintosystrayicon(ev->window))
-			return;
 
-		for (m = mons; m; m = m->next) {
-			if (ev->window == m->barwin || ev->window == m->container) {
-				isbar = 1;
-				break;
-			}
-		}
-		if (isbar)
+		/* clients, tray icons, bars and containers are all dwm-owned */
+		if (ev->window == borderwin || winindexget(&winindex, ev->window))
 			return;
 
 		if (!XGetWindowAttributes(dpy, ev->window, &wa))
@@ -2374,6 +2543,8 @@ configurerequest(XEvent *e)
 	Monitor *m;
 	XConfigureRequestEvent *ev = &e->xconfigurerequest;
 	XWindowChanges wc;
+	unsigned long serial;
+	int oldw, oldh;
 
 	if ((c = wintoclient(ev->window))) {
 		if (c->isfloating || !selmon->lt[selmon->sellt]->arrange) {
@@ -2404,10 +2575,28 @@ configurerequest(XEvent *e)
 				else if (c->y > maxy)
 					c->y = maxy;
 			}
-			if ((ev->value_mask & (CWX|CWY)) && !(ev->value_mask & (CWWidth|CWHeight)))
-				configure(c);
+			/* ICCCM 4.1.5: every request gets an answer, from the
+			 * server if we resize, a synthetic one otherwise, even
+			 * when the client was told this geometry before */
+			serial = NextRequest(dpy);
+			oldw = c->srv.w;
+			oldh = c->srv.h;
+			c->told.w = 0;
 			if (ISVISIBLE(c))
 				resizeclient(c, c->x, c->y, c->w, c->h);
+			else if (c->w != c->srv.w || c->h != c->srv.h) {
+				/* keep the hidden window's size in step with c->w/h,
+				 * scroll() skips clients whose rectangle is unchanged;
+				 * the server tells the client about the new size */
+				c->mon->scrolls[c->tagindex].gen++;
+				setshadow(c, c->srv.x, c->srv.y, c->w, c->h);
+				XResizeWindow(dpy, c->win, c->w, c->h);
+				applyroundedcorners(c->win);
+			}
+			/* moved, refused, held for a sync request or parked: ours,
+			 * unless resizeclient() already sent it */
+			if ((long)(c->srvserial - serial) < 0 || (c->srv.w == oldw && c->srv.h == oldh))
+				configurestale(c);
 		} else
 			configure(c);
 	} else {
@@ -2420,8 +2609,6 @@ configurerequest(XEvent *e)
 		wc.stack_mode = ev->detail;
 		XConfigureWindow(dpy, ev->window, ev->value_mask, &wc);
 	}
-	
-	XSync(dpy, False);
 }
 
 Monitor *
@@ -2429,6 +2616,7 @@ createmon(void)
 {
 	Monitor *m;
 	XSetWindowAttributes wa;
+	int i;
 
 	m = ecalloc(1, sizeof(Monitor));
 	m->showbar = showbar;
@@ -2447,6 +2635,14 @@ createmon(void)
 	m->container = XCreateWindow(dpy, root, 0, 0, 1, 1, 0,
 		DefaultDepth(dpy, screen), CopyFromParent, DefaultVisual(dpy, screen),
 		CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+	winindexadd(&winindex, m->container, WinContainer, m);
+	wa.event_mask = SubstructureRedirectMask|SubstructureNotifyMask;
+	for (i = 0; i < LENGTH(tags); i++) {
+		m->scrolls[i].strip = XCreateWindow(dpy, m->container, 0, 0, STRIPSIZE, STRIPSIZE, 0,
+			DefaultDepth(dpy, screen), CopyFromParent, DefaultVisual(dpy, screen),
+			CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		winindexadd(&winindex, m->scrolls[i].strip, WinStrip, m);
+	}
 	XMapWindow(dpy, m->container);
 	redirectmonitor(m);
 
@@ -2471,13 +2667,20 @@ destroynotify(XEvent *e)
 void
 detachstack(Client *c)
 {
-	Client **tc, *t;
+	Client *t;
 
 	if (!c->mon)
 		return;
 
-	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
-	*tc = c->snext;
+	if (c->sprev)
+		c->sprev->snext = c->snext;
+	else if (c->mon->stack == c)
+		c->mon->stack = c->snext;
+	else
+		return; /* not on the stack */
+	if (c->snext)
+		c->snext->sprev = c->sprev;
+	c->snext = c->sprev = NULL;
 
 	if (c == c->mon->sel) {
 		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
@@ -2488,18 +2691,27 @@ detachstack(Client *c)
 void
 detach(Client *c)
 {
-	Client **tc;
+	Scroll *s;
 	int i = c->tagindex;
 	
 	if (i < 0 || i >= LENGTH(tags))
 		return;
+	s = &c->mon->scrolls[i];
 	
-	/* Find and remove client from scroll list */
-	for (tc = &c->mon->scrolls[i].head; *tc && *tc != c; tc = &(*tc)->next);
-	if (*tc) {
-		*tc = c->next;
-		c->next = NULL;
-	}
+	/* Unlink client from scroll list */
+	if (c->prev)
+		c->prev->next = c->next;
+	else if (s->head == c)
+		s->head = c->next;
+	else
+		return; /* not attached */
+	if (c->next)
+		c->next->prev = c->prev;
+	else
+		s->tail = c->prev;
+	c->next = c->prev = NULL;
+	s->indexed = 0;
+	s->gen++;
 }
 
 void
@@ -2511,6 +2723,11 @@ drawbar(Monitor *m)
 
 	if (!m->showbar)
 		return;
+	if (batching) {
+		m->dirty |= DirtyBar;
+		return;
+	}
+	STATBEGIN();
 
 	/* count visible clients */
 	for (int i = 0; i < LENGTH(tags); i++) {
@@ -2546,6 +2763,7 @@ drawbar(Monitor *m)
 		         (systandstat - TEXTW(str)) / 2, str, 1);
 		drw_map(drw, m->barwin, 0, 0, m->ww, bh);
 	}
+	STATEND(StatDrawbar);
 }
 
 void
@@ -2589,13 +2807,11 @@ expose(XEvent *e)
 		if (m == selmon) {
 			updatesystray();
 			/* Copy cache to bar if available */
-			pthread_mutex_lock(&statuscache_mutex);
 			if (cachevalid && statuscache != None) {
 				XCopyArea(dpy, statuscache, selmon->barwin, statusdrw->gc, 
 						  0, 0, cachew, bh,
 						  selmon->ww - cachew, 0);
 			}
-			pthread_mutex_unlock(&statuscache_mutex);
 		}
 	}
 }
@@ -2721,8 +2937,6 @@ getstate(Window w)
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
 {
-	char **list = NULL;
-	int n;
 	XTextProperty name;
 
 	if (!text || size == 0)
@@ -2730,19 +2944,28 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	text[0] = '\0';
 	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
 		return 0;
-	if (name.encoding == XA_STRING) {
-		size_t len = MIN((size_t)name.nitems, (size_t)size - 1);
-		memcpy(text, name.value, len);
+	textproptostr(&name, text, size);
+	XFree(name.value);
+	return 1;
+}
+
+void
+textproptostr(XTextProperty *name, char *text, unsigned int size)
+{
+	char **list = NULL;
+	int n;
+
+	if (name->encoding == XA_STRING) {
+		size_t len = MIN((size_t)name->nitems, (size_t)size - 1);
+		memcpy(text, name->value, len);
 		text[len] = '\0';
-	} else if (XmbTextPropertyToTextList(dpy, &name, &list, &n) >= Success) {
+	} else if (XmbTextPropertyToTextList(dpy, name, &list, &n) >= Success) {
 		if (n > 0 && list && *list)
 			snprintf(text, size, "%s", *list);
 		if (list)
 			XFreeStringList(list);
 	}
 	text[size - 1] = '\0';
-	XFree(name.value);
-	return 1;
 }
 
 void
@@ -2813,6 +3036,16 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 }
 #endif /* XINERAMA */
 
+static void
+runkey(const Key *k)
+{
+	uint64_t t = nowns();
+
+	histpend(&keydone[k - keys], t);
+	k->func(&k->arg);
+	histadd(&keyhist[k - keys], nowns() - t);
+}
+
 void
 keypress(XEvent *e)
 {
@@ -2832,14 +3065,14 @@ keypress(XEvent *e)
 			if (keysym == XK_f
 			&& CLEANMASK(keys[i].mod) == (MODKEY|ShiftMask)
 			&& keys[i].func == togglefullscreen) {
-				keys[i].func(&(keys[i].arg));
+				runkey(&keys[i]);
 				return;
 			}
 		} else {
 			if (keysym == keys[i].keysym
 			&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
 			&& keys[i].func)
-				keys[i].func(&(keys[i].arg));
+				runkey(&keys[i]);
 		}
 	}
 }
@@ -2861,15 +3094,164 @@ killclient(const Arg *arg)
 	}
 }
 
+/* decode a text property reply the way gettextprop() decodes XGetTextProperty */
+static void
+replytext(xcb_get_property_reply_t *r, char *text, unsigned int size)
+{
+	XTextProperty name;
+
+	text[0] = '\0';
+	if (!r || r->type == None || !r->value_len)
+		return;
+	name.value = xcb_get_property_value(r);
+	name.encoding = r->type;
+	name.format = r->format;
+	name.nitems = r->value_len;
+	textproptostr(&name, text, size);
+}
+
+static unsigned long
+replycard32(xcb_get_property_reply_t *r, Atom type)
+{
+	if (!r || r->type != type || r->format != 32 || !r->value_len)
+		return 0;
+	return ((uint32_t *)xcb_get_property_value(r))[0];
+}
+
+void
+requestprops(Window w, WinProps *p)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	uint32_t textlen = sizeof p->name; /* in 32-bit units, room for multibyte text */
+
+	p->ck[PropNetName] = xcb_get_property(xc, 0, w, netatom[NetWMName], XCB_GET_PROPERTY_TYPE_ANY, 0, textlen);
+	p->ck[PropName] = xcb_get_property(xc, 0, w, XA_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, textlen);
+	p->ck[PropTrans] = xcb_get_property(xc, 0, w, XA_WM_TRANSIENT_FOR, XA_WINDOW, 0, 1);
+	p->ck[PropClass] = xcb_get_property(xc, 0, w, XA_WM_CLASS, XA_STRING, 0, textlen);
+	p->ck[PropState] = xcb_get_property(xc, 0, w, netatom[NetWMState], XA_ATOM, 0, 1);
+	p->ck[PropType] = xcb_get_property(xc, 0, w, netatom[NetWMWindowType], XA_ATOM, 0, 1);
+	p->ck[PropNormalHints] = xcb_get_property(xc, 0, w, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 0, 18);
+	p->ck[PropHints] = xcb_get_property(xc, 0, w, XA_WM_HINTS, XA_WM_HINTS, 0, 9);
+	p->ck[PropProtocols] = xcb_get_property(xc, 0, w, wmatom[WMProtocols], XA_ATOM, 0, 16);
+	p->ck[PropSyncCounter] = xcb_get_property(xc, 0, w, netatom[NetWMSyncRequestCounter], XA_CARDINAL, 0, 1);
+}
+
+void
+collectprops(WinProps *p)
+{
+	xcb_connection_t *xc = XGetXCBConnection(dpy);
+	xcb_get_property_reply_t *r[PropLast];
+	xcb_generic_error_t *err;
+	uint32_t *v;
+	char *s;
+	int i, n, len;
+
+#ifdef XSTATS
+	xroundtrips++; /* the replies arrive together */
+#endif /* XSTATS */
+	for (i = 0; i < PropLast; i++) {
+		err = NULL;
+		r[i] = xcb_get_property_reply(xc, p->ck[i], &err);
+		free(err); /* BadWindow: the window is already gone, treat as unset */
+	}
+
+	replytext(r[PropName], p->wmname, sizeof p->wmname);
+	replytext(r[PropNetName], p->name, sizeof p->name);
+	if (!p->name[0])
+		memcpy(p->name, p->wmname, sizeof p->name);
+	p->trans = replycard32(r[PropTrans], XA_WINDOW);
+	p->state = replycard32(r[PropState], XA_ATOM);
+	p->wtype = replycard32(r[PropType], XA_ATOM);
+
+	/* WM_CLASS is "instance\0class\0" */
+	p->hasclass = 0;
+	p->class[0] = p->instance[0] = '\0';
+	if (r[PropClass] && r[PropClass]->type == XA_STRING && r[PropClass]->format == 8) {
+		s = xcb_get_property_value(r[PropClass]);
+		len = r[PropClass]->value_len;
+		for (n = 0; n < len && s[n]; n++);
+		snprintf(p->instance, sizeof p->instance, "%.*s", n, s);
+		if (n < len) {
+			s += n + 1;
+			len -= n + 1;
+			for (n = 0; n < len && s[n]; n++);
+			snprintf(p->class, sizeof p->class, "%.*s", n, s);
+		}
+		p->hasclass = 1;
+	}
+
+	/* same layout and old-client handling as XGetWMNormalHints */
+	p->hassize = 0;
+	if (r[PropNormalHints] && r[PropNormalHints]->type == XA_WM_SIZE_HINTS
+	&& r[PropNormalHints]->format == 32 && r[PropNormalHints]->value_len >= 15) {
+		v = xcb_get_property_value(r[PropNormalHints]);
+		memset(&p->size, 0, sizeof p->size);
+		p->size.flags = v[0];
+		p->size.min_width = (int32_t)v[5];
+		p->size.min_height = (int32_t)v[6];
+		p->size.max_width = (int32_t)v[7];
+		p->size.max_height = (int32_t)v[8];
+		p->size.width_inc = (int32_t)v[9];
+		p->size.height_inc = (int32_t)v[10];
+		p->size.min_aspect.x = (int32_t)v[11];
+		p->size.min_aspect.y = (int32_t)v[12];
+		p->size.max_aspect.x = (int32_t)v[13];
+		p->size.max_aspect.y = (int32_t)v[14];
+		if (r[PropNormalHints]->value_len >= 18) {
+			p->size.base_width = (int32_t)v[15];
+			p->size.base_height = (int32_t)v[16];
+			p->size.win_gravity = (int32_t)v[17];
+		} else
+			p->size.flags &= ~(PBaseSize|PWinGravity);
+		p->hassize = 1;
+	}
+
+	/* same layout as XGetWMHints; window_group is optional */
+	p->haswmh = 0;
+	if (r[PropHints] && r[PropHints]->type == XA_WM_HINTS
+	&& r[PropHints]->format == 32 && r[PropHints]->value_len >= 8) {
+		v = xcb_get_property_value(r[PropHints]);
+		memset(&p->wmh, 0, sizeof p->wmh);
+		p->wmh.flags = v[0];
+		p->wmh.input = v[1] ? True : False;
+		p->wmh.initial_state = (int32_t)v[2];
+		p->wmh.icon_pixmap = v[3];
+		p->wmh.icon_window = v[4];
+		p->wmh.icon_x = (int32_t)v[5];
+		p->wmh.icon_y = (int32_t)v[6];
+		p->wmh.icon_mask = v[7];
+		if (r[PropHints]->value_len >= 9)
+			p->wmh.window_group = v[8];
+		else
+			p->wmh.flags &= ~WindowGroupHint;
+		p->haswmh = 1;
+	}
+
+	p->synccounter = None;
+	if (r[PropProtocols] && r[PropProtocols]->type == XA_ATOM && r[PropProtocols]->format == 32) {
+		v = xcb_get_property_value(r[PropProtocols]);
+		for (n = 0; n < (int)r[PropProtocols]->value_len; n++)
+			if (v[n] == netatom[NetWMSyncRequest])
+				p->synccounter = replycard32(r[PropSyncCounter], XA_CARDINAL);
+	}
+
+	for (i = 0; i < PropLast; i++)
+		free(r[i]);
+}
+
 void
 manage(Window w, XWindowAttributes *wa)
 {
 	Client *c, *t = NULL;
-	Window trans = None;
 	XWindowChanges wc;
+	WinProps wp;
+	unsigned long placed;
 
+	/* all property requests leave before the first reply is read */
+	requestprops(w, &wp);
 	c = ecalloc(1, sizeof(Client));
 	c->win = w;
+	c->visual = wa->visual;
 	/* geometry */
 	c->x = c->oldx = wa->x;
 	c->y = c->oldy = wa->y;
@@ -2878,13 +3260,16 @@ manage(Window w, XWindowAttributes *wa)
 	c->mfact = mfactdefault;
 	c->ignoreunmap = 0;
 
-	updatetitle(c);
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) {
+	collectprops(&wp);
+	memcpy(c->name, wp.name, sizeof c->name);
+	if (c->name[0] == '\0') /* hack to mark broken clients */
+		snprintf(c->name, sizeof(c->name), "%s", broken);
+	if (wp.trans && (t = wintoclient(wp.trans))) {
 		c->mon = t->mon;
 		c->tagindex = t->tagindex;
 	} else {
 		c->mon = selmon;
-		applyrules(c);
+		applyrules(c, wp.hasclass ? wp.class : broken, wp.hasclass ? wp.instance : broken);
 	}
 
 	if (c->x + c->w > c->mon->wx + c->mon->ww)
@@ -2896,28 +3281,31 @@ manage(Window w, XWindowAttributes *wa)
 	int scrollx = (c->mon && c->mon->scrollindex) ? c->mon->scrollindex->x : 0;
 	c->floatx = c->x + scrollx;
 	c->floaty = c->y;
-	wc.border_width = 0;
-	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
-	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
+	c->radius = cornerradiusfor(wp.hasclass ? wp.class : NULL, wp.hasclass ? wp.instance : NULL,
+		wp.wmname[0] ? wp.wmname : NULL, wa->override_redirect);
+	setwindowtype(c, wp.state, wp.wtype);
+	if (!wp.hassize)
+		wp.size.flags = PSize;
+	setsizehints(c, &wp.size);
+	if (wp.haswmh)
+		setwmhints(c, &wp.wmh);
+	if (sync_supported)
+		c->synccounter = wp.synccounter;
 	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
-		c->isfloating = c->oldstate = trans != None || c->isfixed || c->h < (c->mon->wh * autofloatthreshold);
+		c->isfloating = c->oldstate = wp.trans != None || c->isfixed || c->h < (c->mon->wh * autofloatthreshold);
 
-	if (c->isfloating)
-		XRaiseWindow(dpy, c->win);
 	attach(c);
 	attachstack(c);
+	winindexadd(&winindex, c->win, WinClient, c);
 	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend,
 		(unsigned char *) &(c->win), 1);
 
-	/* Reparent client window into container */
+	/* Reparent client window into its tag's strip, at its size and the
+	 * position it has now (reparenting is itself the move) */
 	c->ignoreunmap = 2;
-	XReparentWindow(dpy, c->win, c->mon->container, c->x - c->mon->wx, c->y - c->mon->wy);
-	XMoveResizeWindow(dpy, c->win, c->x - c->mon->wx, c->y - c->mon->wy, c->w, c->h);
+	reparentstrip(c);
 	c->ignoreunmap = 0;
 
 	setclientstate(c, NormalState);
@@ -2926,13 +3314,23 @@ manage(Window w, XWindowAttributes *wa)
 		unfocus(selmon->sel, 0);
 	if (visible)
 		c->mon->sel = c;
+	if (c->isfloating && c->mon->scrollindex)
+		reorderbyx(&c->mon->scrolls[c->tagindex]);
+	/* settle the pan first, then lay out once: the window gets its final
+	 * geometry, border and shape in one configure before it is mapped */
+	if (visible && c->mon == selmon && !c->isfullscreen)
+		revealnew(c);
+	placed = NextRequest(dpy);
 	arrange(c->mon);
-	if (c->isfloating && c->mon && c->mon->scrollindex)
-		reorderbyx(c->mon->scrollindex);
+	syncarrange(c->mon);
+	if ((long)(c->srvserial - placed) < 0) {
+		/* the layout left it where it is: only the border and shape */
+		wc.border_width = 0;
+		XConfigureWindow(dpy, w, CWBorderWidth, &wc);
+		configure(c); /* propagates border_width, if size doesn't change */
+		applyroundedcorners(c->win);
+	}
 	XMapWindow(dpy, c->win);
-	applyroundedcorners(c->win);
-	if (visible && c->mon == selmon && !c->isfullscreen)
-		ensureclientvisible(c, c->w, 50);
 	if (visible && c->mon == selmon) {
 		focus(c);
 		restack(selmon);
@@ -3014,7 +3412,7 @@ motionnotify(XEvent *e)
 void
 movemouse(const Arg *arg)
 {
-	int x, y, ocx, ocy, nx, ny;
+	int x, y, ocx, ocy, nx, ny, wasbatching;
 	Client *c;
 	Monitor *m;
 	XEvent ev;
@@ -3024,16 +3422,18 @@ movemouse(const Arg *arg)
 		return;
 	if (c->isfullscreen) /* no support moving fullscreen windows by mouse */
 		return;
+	wasbatching = pausebatch();
 	restack(selmon);
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
 		None, cursor[CurMove]->cursor, CurrentTime) != GrabSuccess)
-		return;
+		goto out;
 	if (!getrootptr(&x, &y))
-		return;
+		goto out;
 	do {
 		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
+		recordevent(&ev, RecModal);
 		switch(ev.type) {
 		case ConfigureRequest:
 		case Expose:
@@ -3071,6 +3471,8 @@ movemouse(const Arg *arg)
 	}
 	if (c->isfloating && c->mon && c->mon->scrollindex)
 		reorderbyx(c->mon->scrollindex);
+out:
+	batching = wasbatching;
 }
 
 
@@ -3105,11 +3507,15 @@ propertynotify(XEvent *e)
 		default: break;
 		case XA_WM_TRANSIENT_FOR:
 			if (!c->isfloating && (XGetTransientForHint(dpy, c->win, &trans)) &&
-				(c->isfloating = (wintoclient(trans)) != NULL))
+				(c->isfloating = (wintoclient(trans)) != NULL)) {
+				c->mon->scrolls[c->tagindex].gen++;
 				arrange(c->mon);
+			}
 			break;
 		case XA_WM_NORMAL_HINTS:
 			c->hintsvalid = 0;
+			/* the next view of a hidden tag must apply them */
+			c->mon->scrolls[c->tagindex].gen++;
 			break;
 		case XA_WM_HINTS:
 			updatewmhints(c);
@@ -3117,6 +3523,8 @@ propertynotify(XEvent *e)
 			break;
 		}
 			if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
+				if (ev->atom == XA_WM_NAME)
+					c->radius = -1; /* cornerrules match on it */
 				updatetitle(c);
 				if (c == c->mon->sel && ISVISIBLE(c))
 					drawbar(c->mon);
@@ -3146,6 +3554,41 @@ recttomon(int x, int y, int w, int h)
 	return r;
 }
 
+/* virtual strip x of c as the server has it, parked clients by where they would be */
+static int
+stripkey(Client *c)
+{
+	Scroll *s = &c->mon->scrolls[c->tagindex];
+
+	return c->parked ? c->x - c->mon->wx + s->x : c->srv.x + s->origin;
+}
+
+/* stable merge sort by stripkey */
+static Client *
+sortbyx(Client *head)
+{
+	Client *a, *b, *slow, *fast, **tail;
+
+	if (!head || !head->next)
+		return head;
+	for (slow = head, fast = head->next; fast && fast->next; fast = fast->next->next)
+		slow = slow->next;
+	b = sortbyx(slow->next);
+	slow->next = NULL;
+	a = sortbyx(head);
+	for (tail = &head; a && b; tail = &(*tail)->next) {
+		if (stripkey(b) < stripkey(a)) {
+			*tail = b;
+			b = b->next;
+		} else {
+			*tail = a;
+			a = a->next;
+		}
+	}
+	*tail = a ? a : b;
+	return head;
+}
+
 static void
 reorderbyx(Scroll *s)
 {
@@ -3155,28 +3598,17 @@ reorderbyx(Scroll *s)
 	Monitor *m = s->head->mon;
 	if (!m)
 		return;
+	syncarrange(m);
 
-	Client *sorted = NULL;
-	for (Client *c = s->head; c; ) {
-		Client *next = c->next;
-		XWindowAttributes wa;
-		int cx = c->x;
-		if (XGetWindowAttributes(dpy, c->win, &wa))
-			cx = wa.x;
-		Client **pp = &sorted;
-		while (*pp) {
-			int px = (*pp)->x;
-			if (XGetWindowAttributes(dpy, (*pp)->win, &wa))
-				px = wa.x;
-			if (px > cx)
-				break;
-			pp = &(*pp)->next;
-		}
-		c->next = *pp;
-		*pp = c;
-		c = next;
-	}
+	Client *sorted = sortbyx(s->head), *prev = NULL;
+
+	/* the sort only follows next, restore prev and the tail */
+	for (Client *c = sorted; c; prev = c, c = c->next)
+		c->prev = prev;
+	s->tail = prev;
 	s->head = sorted;
+	s->indexed = 0;
+	s->gen++;
 	if (m)
 		drawbar(m);
 }
@@ -3191,6 +3623,7 @@ removesystrayicon(Client *i)
 	for (ii = &systray->icons; *ii && *ii != i; ii = &(*ii)->next);
 	if (*ii == i)
 		*ii = i->next;
+	winindexdel(&winindex, i->win);
 	free(i);
 }
 
@@ -3215,22 +3648,47 @@ void
 resizeclient(Client *c, int x, int y, int w, int h)
 {
 	XWindowChanges wc;
+	int resized;
 
 	c->oldx = c->x; c->x = wc.x = x;
 	c->oldy = c->y; c->y = wc.y = y;
 	c->oldw = c->w; c->w = wc.width = w;
 	c->oldh = c->h; c->h = wc.height = h;
 	
-	/* translate to container coordinates */
-	wc.x = x - c->mon->wx;
+	/* translate to coordinates in the tag's strip */
+	Scroll *s = &c->mon->scrolls[c->tagindex];
+	s->gen++;
+	c->stripx = x - c->mon->wx + s->x;
+	wc.x = STRIPX(c);
 	wc.y = y - c->mon->wy;
-	int scrollx = (c->mon && c->mon->scrollindex) ? c->mon->scrollindex->x : 0;
-	c->floatx = x + scrollx;
+	c->floatx = x + s->x;
 	c->floaty = y;
+	/* out of reach of the strip window: only track it */
+	if (!INSTRIP(wc.x)) {
+		parkclient(c);
+		return;
+	}
+	/* a client that repaints on request gets one new size at a time, the
+	 * sizes asked for meanwhile collapse into the latest */
+	if (c->synccounter && (w != c->srv.w || h != c->srv.h)) {
+		if (c->syncsent && nowns() - c->syncsent < SYNCTIMEOUT) {
+			c->syncpending = 1;
+			return;
+		}
+		syncrequest(c);
+	}
+	c->parked = 0;
 
 	wc.border_width = 0;
+	resized = w != c->srv.w || h != c->srv.h;
+	setshadow(c, wc.x, wc.y, w, h);
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
-	configure(c);
+	/* a new size brings the server's ConfigureNotify, a move inside the
+	 * strip one in strip coordinates only */
+	if (resized)
+		c->told.w = 0;
+	else
+		configurestale(c);
 	applyroundedcorners(c->win);
 	if (c == selmon->sel)
 		updateborderwin();
@@ -3259,6 +3717,7 @@ resizemouse(const Arg *arg)
 	Time lasttime = 0;
 	int drawnborder = 0;
 	int rw = 0, rh = 0;
+	int wasbatching;
 	GC gc;
 	XGCValues gcv;
 
@@ -3266,12 +3725,15 @@ resizemouse(const Arg *arg)
 		return;
 	if (c->isfullscreen) /* no support resizing fullscreen windows by mouse */
 		return;
+	wasbatching = pausebatch();
 	restack(selmon);
 	ocx = c->x;
 	ocy = c->y;
 	if (XGrabPointer(dpy, root, False, MOUSEMASK, GrabModeAsync, GrabModeAsync,
-		None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess)
+		None, cursor[CurResize]->cursor, CurrentTime) != GrabSuccess) {
+		batching = wasbatching;
 		return;
+	}
 	XWarpPointer(dpy, None, c->win, 0, 0, 0, 0, c->w - 1, c->h - 1);
 	gcv.function = GXxor;
 	gcv.foreground = scheme[SchemeSel][ColBorder].pixel;
@@ -3280,6 +3742,7 @@ resizemouse(const Arg *arg)
 	gc = XCreateGC(dpy, root, GCFunction|GCForeground|GCLineWidth|GCSubwindowMode, &gcv);
 	do {
 		XMaskEvent(dpy, MOUSEMASK|ExposureMask|SubstructureRedirectMask, &ev);
+		recordevent(&ev, RecModal);
 		switch(ev.type) {
 		case ConfigureRequest:
 		case Expose:
@@ -3290,7 +3753,7 @@ resizemouse(const Arg *arg)
 			if ((ev.xmotion.time - lasttime) <= (1000 / refreshrate))
 				continue;
 			while (XCheckTypedEvent(dpy, MotionNotify, &ev))
-				;
+				recordevent(&ev, RecModal);
 			lasttime = ev.xmotion.time;
 
 			nw = MAX(ev.xmotion.x - ocx + 1, 1);
@@ -3328,22 +3791,29 @@ resizemouse(const Arg *arg)
 		selmon = m;
 		focus(NULL);
 	}
+	batching = wasbatching;
 }
 
 void
 restack(Monitor *m)
 {
 	Client *c;
-	XEvent ev;
 	XWindowChanges wc;
 	Client **floats = NULL;
 	int fcount = 0;
 	int i;
 	int usearrange;
 
+	if (batching) {
+		m->dirty |= DirtyStack;
+		return;
+	}
+	STATBEGIN();
 	drawbar(m);
-	if (!m->sel)
+	if (!m->sel) {
+		STATEND(StatRestack);
 		return;
+	}
 
 	usearrange = m->lt[m->sellt]->arrange != NULL;
 
@@ -3372,28 +3842,822 @@ restack(Monitor *m)
 		free(floats);
 	}
 
-	XSync(dpy, False);
-	while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	/* crossings the restack causes carry a serial below the NoOp's; real
+	 * pointer motion after it does not, so no round trip is needed */
+	enterserial = NextRequest(dpy);
+	XNoOp(dpy);
+	STATEND(StatRestack);
 }
 
-void
-run(void)
+static Bool
+issameconfigurerequest(Display *d, XEvent *ev, XPointer arg)
 {
-	XEvent ev;
-	/* main event loop */
-	XSync(dpy, False);
-	while (running && !XNextEvent(dpy, &ev))
-		if (handler[ev.type])
-			handler[ev.type](&ev); /* call handler */
+	return ev->type == ConfigureRequest
+		&& ev->xconfigurerequest.window == ((XConfigureRequestEvent *)arg)->window;
 }
 
-void
-runautostart(void)
+/* fold queued ConfigureRequests for the same window into ev, last value wins */
+static void
+coalesceconfigurerequest(XConfigureRequestEvent *ev)
 {
-	char *home, *path;
-
-	if (!autostartscript || !*autostartscript)
-		return;
+	XEvent next;
+	XConfigureRequestEvent *n = &next.xconfigurerequest;
+
+	while (XCheckIfEvent(dpy, &next, issameconfigurerequest, (XPointer)ev)) {
+		if (n->value_mask & CWX)
+			ev->x = n->x;
+		if (n->value_mask & CWY)
+			ev->y = n->y;
+		if (n->value_mask & CWWidth)
+			ev->width = n->width;
+		if (n->value_mask & CWHeight)
+			ev->height = n->height;
+		if (n->value_mask & CWBorderWidth)
+			ev->border_width = n->border_width;
+		if (n->value_mask & CWSibling)
+			ev->above = n->above;
+		if (n->value_mask & CWStackMode)
+			ev->detail = n->detail;
+		ev->value_mask |= n->value_mask;
+	}
+}
+
+#ifdef XSTATS
+XStat
+xstatnow(void)
+{
+	XStat now = { 0, NextRequest(dpy), xroundtrips, xbytes, xconfigures };
+	return now;
+}
+
+void
+xstatadd(int id, XStat *start)
+{
+	XStat now = xstatnow();
+
+	xstats[id].calls++;
+	xstats[id].requests += now.requests - start->requests;
+	xstats[id].roundtrips += now.roundtrips - start->roundtrips;
+	xstats[id].bytes += now.bytes - start->bytes;
+	xstats[id].configures += now.configures - start->configures;
+}
+
+static void
+countflush(Display *d, XExtCodes *codes, const char *data, long len)
+{
+	xbytes += len;
+}
+#endif /* XSTATS */
+
+void
+handleevent(XEvent *ev)
+{
+	uint64_t t;
+
+	if (!handler[ev->type])
+		return;
+	t = nowns();
+	histpend(&evdone[ev->type], t);
+	STATBEGIN();
+	handler[ev->type](ev); /* call handler */
+	STATEND(ev->type);
+	histadd(&evhist[ev->type], nowns() - t);
+}
+
+void
+flushbatch(void)
+{
+	uint64_t t = nowns();
+
+	batching = 0;
+	flushdirty();
+	/* the one flush per batch; handlers and drw_map only queue requests */
+	XFlush(dpy);
+	histadd(&flushhist, nowns() - t);
+	t = nowns();
+	for (int i = 0; i < npending; i++)
+		histadd(pending[i].h, t - pending[i].t);
+	npending = 0;
+}
+
+/* drain the whole burst, then run each expensive pass once */
+static void
+dispatchevents(void)
+{
+	XEvent ev;
+
+	batching = batchevents;
+	while (running && XPending(dpy)) {
+		XNextEvent(dpy, &ev);
+		if (sync_supported && ev.type == syncevbase + XSyncAlarmNotify) {
+			syncalarmnotify(&ev);
+			continue;
+		} else if (ev.type == ConfigureRequest)
+			coalesceconfigurerequest(&ev.xconfigurerequest);
+		else if (ev.type == MotionNotify)
+			while (XCheckTypedWindowEvent(dpy, ev.xmotion.window, MotionNotify, &ev));
+		else if (ev.type == EnterNotify && (long)(ev.xany.serial - enterserial) < 0)
+			continue;
+		recordevent(&ev, RecEvent);
+		handleevent(&ev);
+	}
+	flushbatch();
+	recordevent(NULL, RecFlush);
+}
+
+/* index of id in recids, or where it would be inserted */
+static int
+idfind(unsigned long id)
+{
+	int lo = 0, hi = nrecids, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (recids[mid].from < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* returns 0 if id was already present */
+static int
+idput(unsigned long id, unsigned long to)
+{
+	int i = idfind(id);
+
+	if (i < nrecids && recids[i].from == id)
+		return 0;
+	if (nrecids == recidscap) {
+		recidscap = recidscap ? recidscap * 2 : 256;
+		if (!(recids = realloc(recids, recidscap * sizeof *recids)))
+			die("fatal: could not realloc() %zu bytes\n", recidscap * sizeof *recids);
+	}
+	memmove(recids + i + 1, recids + i, (nrecids - i) * sizeof *recids);
+	recids[i].from = id;
+	recids[i].to = to;
+	nrecids++;
+	return 1;
+}
+
+static void
+iddel(unsigned long id)
+{
+	int i = idfind(id);
+
+	if (i < nrecids && recids[i].from == id) {
+		memmove(recids + i, recids + i + 1, (nrecids - i - 1) * sizeof *recids);
+		nrecids--;
+	}
+}
+
+static unsigned long
+idget(unsigned long id)
+{
+	int i = idfind(id);
+
+	return (i < nrecids && recids[i].from == id) ? recids[i].to : None;
+}
+
+static size_t
+eventsize(int type)
+{
+	switch (type) {
+	case KeyPress: case KeyRelease: return sizeof(XKeyEvent);
+	case ButtonPress: case ButtonRelease: return sizeof(XButtonEvent);
+	case MotionNotify: return sizeof(XMotionEvent);
+	case EnterNotify: case LeaveNotify: return sizeof(XCrossingEvent);
+	case FocusIn: case FocusOut: return sizeof(XFocusChangeEvent);
+	case Expose: return sizeof(XExposeEvent);
+	case DestroyNotify: return sizeof(XDestroyWindowEvent);
+	case UnmapNotify: return sizeof(XUnmapEvent);
+	case MapNotify: return sizeof(XMapEvent);
+	case MapRequest: return sizeof(XMapRequestEvent);
+	case ConfigureNotify: return sizeof(XConfigureEvent);
+	case ConfigureRequest: return sizeof(XConfigureRequestEvent);
+	case ResizeRequest: return sizeof(XResizeRequestEvent);
+	case PropertyNotify: return sizeof(XPropertyEvent);
+	case ClientMessage: return sizeof(XClientMessageEvent);
+	case MappingNotify: return sizeof(XMappingEvent);
+	default: return sizeof(XEvent);
+	}
+}
+
+/* visit every window and atom an event refers to */
+void
+eventxids(XEvent *ev, void (*win)(Window *), void (*atom)(Atom *))
+{
+	Window w;
+	Atom a;
+
+	win(&ev->xany.window);
+	switch (ev->type) {
+	case KeyPress: case KeyRelease:
+		win(&ev->xkey.root);
+		win(&ev->xkey.subwindow);
+		break;
+	case ButtonPress: case ButtonRelease:
+		win(&ev->xbutton.root);
+		win(&ev->xbutton.subwindow);
+		break;
+	case MotionNotify:
+		win(&ev->xmotion.root);
+		win(&ev->xmotion.subwindow);
+		break;
+	case EnterNotify: case LeaveNotify:
+		win(&ev->xcrossing.root);
+		win(&ev->xcrossing.subwindow);
+		break;
+	case DestroyNotify: win(&ev->xdestroywindow.window); break;
+	case UnmapNotify: win(&ev->xunmap.window); break;
+	case MapNotify: win(&ev->xmap.window); break;
+	case MapRequest: win(&ev->xmaprequest.window); break;
+	case ConfigureNotify:
+		win(&ev->xconfigure.window);
+		win(&ev->xconfigure.above);
+		break;
+	case ConfigureRequest:
+		win(&ev->xconfigurerequest.window);
+		win(&ev->xconfigurerequest.above);
+		break;
+	case PropertyNotify: atom(&ev->xproperty.atom); break;
+	case ClientMessage:
+		atom(&ev->xclient.message_type);
+		if (ev->xclient.message_type == netatom[NetWMState]) {
+			a = ev->xclient.data.l[1];
+			atom(&a);
+			ev->xclient.data.l[1] = a;
+			a = ev->xclient.data.l[2];
+			atom(&a);
+			ev->xclient.data.l[2] = a;
+		} else if (ev->xclient.message_type == netatom[NetSystemTrayOP]) {
+			w = ev->xclient.data.l[2];
+			win(&w);
+			ev->xclient.data.l[2] = w;
+		}
+		break;
+	}
+}
+
+static void
+putrec(int kind, const void *data, size_t len)
+{
+	uint64_t d = (nowns() - reclast) / 1000;
+	uint32_t dt = MIN(d, UINT32_MAX);
+	uint16_t n = len;
+
+	reclast += (uint64_t)dt * 1000;
+	fputc(kind, recfp);
+	fwrite(&dt, sizeof dt, 1, recfp);
+	fwrite(&n, sizeof n, 1, recfp);
+	if (len)
+		fwrite(data, 1, len, recfp);
+}
+
+/* describe a window the first time an event names it */
+static void
+recordwin(Window *w)
+{
+	char buf[sizeof(RecWin) + 3 * 256], name[256] = "";
+	RecWin r = { *w, RecWinOther, -1, -1, 0, 0, 0, 0, 0 };
+	XClassHint ch = { NULL, NULL };
+	XWindowAttributes wa;
+	WinEntry *e;
+	size_t len;
+
+	if (!*w || !idput(*w, *w))
+		return;
+	if (*w == root)
+		r.kind = RecWinRoot;
+	else if (*w == borderwin)
+		r.kind = RecWinBorder;
+	else if (systray && *w == systray->win)
+		r.kind = RecWinSystray;
+	else if ((e = winindexget(&winindex, *w)) && (e->kind == WinBar || e->kind == WinContainer)) {
+		r.kind = e->kind == WinBar ? RecWinBar : RecWinContainer;
+		r.mon = ((Monitor *)e->p)->num;
+	} else if (e && e->kind == WinStrip) {
+		/* parent of every client: the target of its requests */
+		r.kind = RecWinStrip;
+		r.mon = ((Monitor *)e->p)->num;
+		for (r.tag = 0; ((Monitor *)e->p)->scrolls[r.tag].strip != *w; r.tag++);
+	} else {
+		if (XGetWindowAttributes(dpy, *w, &wa)) {
+			r.x = wa.x;
+			r.y = wa.y;
+			r.w = wa.width;
+			r.h = wa.height;
+			r.override = wa.override_redirect;
+		}
+		gettextprop(*w, XA_WM_NAME, name, sizeof name);
+		XGetClassHint(dpy, *w, &ch);
+	}
+	memcpy(buf, &r, sizeof r);
+	len = sizeof r;
+	len += snprintf(buf + len, sizeof buf - len, "%.255s", name) + 1;
+	len += snprintf(buf + len, sizeof buf - len, "%.255s", ch.res_name ? ch.res_name : "") + 1;
+	len += snprintf(buf + len, sizeof buf - len, "%.255s", ch.res_class ? ch.res_class : "") + 1;
+	if (ch.res_name)
+		XFree(ch.res_name);
+	if (ch.res_class)
+		XFree(ch.res_class);
+	putrec(RecWindow, buf, len);
+}
+
+static void
+recordatom(Atom *a)
+{
+	char buf[sizeof(uint64_t) + 256], *name;
+	uint64_t id = *a;
+	int n;
+
+	if (*a <= XA_LAST_PREDEFINED || !idput(*a | RECATOM, *a))
+		return;
+	if (!(name = XGetAtomName(dpy, *a)))
+		return;
+	memcpy(buf, &id, sizeof id);
+	n = snprintf(buf + sizeof id, sizeof buf - sizeof id, "%.255s", name);
+	putrec(RecAtom, buf, sizeof id + n + 1);
+	XFree(name);
+}
+
+/* kind is RecEvent for the main loop, RecModal inside movemouse, resizemouse
+ * and previewscroll, RecFlush (with no event) at the end of a batch */
+void
+recordevent(XEvent *ev, int kind)
+{
+	if (!recfp)
+		return;
+	/* a cookie has no payload before XGetEventData, see RecPanRec */
+	if (ev && ev->type == GenericEvent)
+		return;
+	if (ev) {
+		eventxids(ev, recordwin, recordatom);
+		putrec(kind, ev, eventsize(ev->type));
+		/* a later window may get the same id */
+		if (ev->type == DestroyNotify)
+			iddel(ev->xdestroywindow.window);
+	} else {
+		putrec(kind, NULL, 0);
+		/* a crash is the session worth replaying, keep its tail */
+		if (kind == RecFlush)
+			fflush(recfp);
+	}
+}
+
+void
+recordpan(Window w, int x, double clicks)
+{
+	RecPanRec r = { w, x, clicks };
+
+	if (!recfp)
+		return;
+	recordwin(&w);
+	putrec(RecPan, &r, sizeof r);
+}
+
+void
+recordopen(const char *path)
+{
+	if (!(recfp = fopen(path, "wb")))
+		die("dwm: cannot open %s:", path);
+	fputs(RECMAGIC, recfp);
+	reclast = nowns();
+}
+
+/* windows managed before recording started replay as MapRequests */
+void
+recordclients(void)
+{
+	XEvent ev = { 0 };
+	Monitor *m;
+	Client *c;
+	int i;
+
+	if (!recfp)
+		return;
+	for (m = mons; m; m = m->next)
+		for (i = 0; i < LENGTH(tags); i++)
+			for (c = m->scrolls[i].head; c; c = c->next) {
+				ev.xmaprequest.type = MapRequest;
+				ev.xmaprequest.parent = root;
+				ev.xmaprequest.window = c->win;
+				recordevent(&ev, RecEvent);
+			}
+	recordevent(NULL, RecFlush);
+}
+
+static void
+replaywin(Window *w)
+{
+	*w = idget(*w);
+}
+
+static void
+replayatom(Atom *a)
+{
+	if (*a > XA_LAST_PREDEFINED)
+		*a = idget(*a | RECATOM);
+}
+
+/* find or create the window a recorded one stands for */
+static void
+replaywinrec(const unsigned char *p, size_t len)
+{
+	XSetWindowAttributes swa;
+	XClassHint ch;
+	Window w = None;
+	const char *name, *end = (const char *)p + len;
+	RecWin r;
+	Monitor *m;
+
+	if (len < sizeof r + 3 || p[len - 1])
+		return;
+	memcpy(&r, p, sizeof r);
+	switch (r.kind) {
+	case RecWinRoot: w = root; break;
+	case RecWinBorder: w = borderwin; break;
+	case RecWinSystray: w = systray ? systray->win : None; break;
+	case RecWinBar: case RecWinContainer:
+		for (m = mons; m && m->num != r.mon; m = m->next);
+		if (m)
+			w = r.kind == RecWinBar ? m->barwin : m->container;
+		break;
+	case RecWinStrip:
+		for (m = mons; m && m->num != r.mon; m = m->next);
+		if (m && r.tag >= 0 && r.tag < LENGTH(tags))
+			w = m->scrolls[r.tag].strip;
+		break;
+	default:
+		/* a stand-in client: left unmapped, the recorded MapRequest maps it */
+		swa.override_redirect = r.override;
+		w = XCreateWindow(dpy, root, r.x, r.y, MAX(r.w, 1), MAX(r.h, 1), 0,
+			CopyFromParent, InputOutput, CopyFromParent, CWOverrideRedirect, &swa);
+		name = (const char *)p + sizeof r;
+		XStoreName(dpy, w, name);
+		ch.res_name = (char *)name + strlen(name) + 1;
+		ch.res_class = ch.res_name < end ? ch.res_name + strlen(ch.res_name) + 1 : NULL;
+		if (ch.res_class && ch.res_class < end)
+			XSetClassHint(dpy, w, &ch);
+		break;
+	}
+	if (!idput(r.id, w))
+		recids[idfind(r.id)].to = w; /* the server reused a destroyed id */
+}
+
+static void
+replaypanrec(const unsigned char *p, size_t len)
+{
+	RecPanRec r;
+
+	if (len != sizeof r)
+		return;
+	memcpy(&r, p, sizeof r);
+	xipan(idget(r.win), r.x, r.clicks);
+}
+
+static void
+replayatomrec(const unsigned char *p, size_t len)
+{
+	uint64_t id;
+
+	if (len < sizeof id + 2 || p[len - 1])
+		return;
+	memcpy(&id, p, sizeof id);
+	idput(id | RECATOM, XInternAtom(dpy, (const char *)p + sizeof id, False));
+}
+
+static int
+replayevent(const unsigned char *p, size_t len, XEvent *ev)
+{
+	memset(ev, 0, sizeof *ev);
+	memcpy(ev, p, MIN(len, sizeof *ev));
+	ev->xany.display = dpy;
+	ev->xany.serial = 0;
+	eventxids(ev, replaywin, replayatom);
+	return ev->type > 0 && ev->type < LASTEvent;
+}
+
+/* feed a recording back through the handlers: paced by the recorded delays,
+ * or back to back when fast is set; events the server sends meanwhile are
+ * dropped so every run sees the same input */
+void
+replay(const char *path, int fast)
+{
+	unsigned char *buf, *p;
+	long size, pos = sizeof RECMAGIC - 1, next;
+	uint64_t start, at = 0, now;
+	uint32_t dt;
+	uint16_t len;
+	XEvent ev, *modal = NULL;
+	int kind, nmodal, capmodal = 0, i;
+	struct timespec ts;
+	FILE *fp;
+
+	if (!(fp = fopen(path, "rb")))
+		die("dwm: cannot open %s:", path);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+	buf = ecalloc(1, size + 1);
+	if (fread(buf, 1, size, fp) != (size_t)size || size < pos || memcmp(buf, RECMAGIC, pos))
+		die("dwm: %s is not an event recording", path);
+	fclose(fp);
+
+	/* no main loop ticks frames here, pans jump like they used to */
+	close(animfd);
+	animfd = -1;
+	start = nowns();
+	batching = batchevents;
+	while (running && pos + 7 <= size) {
+		kind = buf[pos];
+		memcpy(&dt, buf + pos + 1, sizeof dt);
+		memcpy(&len, buf + pos + 5, sizeof len);
+		p = buf + pos + 7;
+		if ((pos += 7 + len) > size)
+			break;
+		at += (uint64_t)dt * 1000;
+		if (!fast && (now = nowns()) < start + at) {
+			XFlush(dpy);
+			ts.tv_sec = (start + at - now) / 1000000000;
+			ts.tv_nsec = (start + at - now) % 1000000000;
+			nanosleep(&ts, NULL);
+		}
+		switch (kind) {
+		case RecWindow: replaywinrec(p, len); break;
+		case RecAtom: replayatomrec(p, len); break;
+		case RecPan: replaypanrec(p, len); break;
+		case RecFlush:
+			flushbatch();
+			batching = batchevents;
+			break;
+		case RecEvent:
+			while (XPending(dpy))
+				XNextEvent(dpy, &ev);
+			if (!replayevent(p, len, &ev))
+				break;
+			/* events a modal loop read while this one was handled go
+			 * back on the queue, where that loop will read them again */
+			for (nmodal = 0; pos + 7 <= size; pos = next) {
+				kind = buf[pos];
+				memcpy(&dt, buf + pos + 1, sizeof dt);
+				memcpy(&len, buf + pos + 5, sizeof len);
+				if ((next = pos + 7 + len) > size
+				|| (kind != RecModal && kind != RecWindow && kind != RecAtom))
+					break;
+				at += (uint64_t)dt * 1000;
+				if (kind == RecWindow)
+					replaywinrec(buf + pos + 7, len);
+				else if (kind == RecAtom)
+					replayatomrec(buf + pos + 7, len);
+				else {
+					if (nmodal == capmodal) {
+						capmodal = capmodal ? capmodal * 2 : 64;
+						if (!(modal = realloc(modal, capmodal * sizeof *modal)))
+							die("fatal: could not realloc() %zu bytes\n", capmodal * sizeof *modal);
+					}
+					if (replayevent(buf + pos + 7, len, &modal[nmodal]))
+						nmodal++;
+				}
+			}
+			for (i = nmodal - 1; i >= 0; i--)
+				XPutBackEvent(dpy, &modal[i]);
+			handleevent(&ev);
+			break;
+		}
+	}
+	flushbatch();
+	XSync(dpy, False);
+	free(modal);
+	free(buf);
+	dumpstats();
+}
+
+uint64_t
+nowns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void
+histadd(Hist *h, uint64_t ns)
+{
+	int i = 0;
+
+	while (i < 63 && ns >> (i + 1))
+		i++;
+	h->bucket[i]++;
+	h->count++;
+	if (ns > h->max)
+		h->max = ns;
+}
+
+/* upper bound of the bucket holding the pct-th percentile, capped at max */
+uint64_t
+histpct(const Hist *h, unsigned int pct)
+{
+	unsigned long want = (h->count * pct + 99) / 100, seen = 0;
+	int i;
+
+	for (i = 0; i < 63; i++)
+		if ((seen += h->bucket[i]) >= want)
+			return MIN((uint64_t)2 << i, h->max);
+	return h->max;
+}
+
+/* add t's sample to h once the batch is flushed */
+void
+histpend(Hist *h, uint64_t t)
+{
+	if (npending == cappending) {
+		cappending = cappending ? cappending * 2 : 64;
+		if (!(pending = realloc(pending, cappending * sizeof *pending)))
+			die("fatal: could not realloc() %zu bytes\n", cappending * sizeof *pending);
+	}
+	pending[npending].h = h;
+	pending[npending++].t = t;
+}
+
+void
+histprint(const char *name, const Hist *h)
+{
+	if (h->count)
+		fprintf(stderr, "dwm: %-18s %8lu %10.1f %10.1f %10.1f\n", name, h->count,
+			histpct(h, 50) / 1e3, histpct(h, 99) / 1e3, h->max / 1e3);
+}
+
+static const char *
+keyfuncname(const Key *k)
+{
+#define F(f) { f, #f }
+	static const struct { void (*func)(const Arg *); const char *name; } names[] = {
+		F(ensureselectedvisible), F(focusstep), F(focusstepvisible), F(killclient),
+		F(movemouse), F(previewscroll), F(quit), F(resizemouse), F(scrollmove),
+		F(scrollmoveothers), F(scrolltogglesize), F(setlayout), F(setmfact),
+		F(spawn), F(tag), F(togglebar), F(togglefloating), F(togglefullscreen),
+		F(view), F(viewlast),
+	};
+#undef F
+	unsigned int i;
+	const char *s;
+
+	for (i = 0; i < LENGTH(names); i++)
+		if (names[i].func == k->func)
+			return names[i].name;
+	return (s = XKeysymToString(k->keysym)) ? s : "?";
+}
+
+/* one row per function, summed over every key bound to it */
+static void
+histprintkeys(const Hist *kh)
+{
+	unsigned int i, j;
+	Hist h;
+
+	for (i = 0; i < LENGTH(keys); i++) {
+		for (j = 0; j < i && keys[j].func != keys[i].func; j++);
+		if (j < i)
+			continue;
+		h = kh[i];
+		for (j = i + 1; j < LENGTH(keys); j++) {
+			if (keys[j].func != keys[i].func)
+				continue;
+			h.count += kh[j].count;
+			h.max = MAX(h.max, kh[j].max);
+			for (int b = 0; b < LENGTH(h.bucket); b++)
+				h.bucket[b] += kh[j].bucket[b];
+		}
+		histprint(keyfuncname(&keys[i]), &h);
+	}
+}
+
+static void
+dumpstats(void)
+{
+	unsigned int i;
+
+	fprintf(stderr, "dwm: %-18s %8s %10s %10s %10s\n", "latency (us)", "count", "p50", "p99", "max");
+	for (i = 0; i < LASTEvent; i++)
+		histprint(evnames[i] ? evnames[i] : "?", &evhist[i]);
+	histprint("flushdirty", &flushhist);
+	histprintkeys(keyhist);
+	fprintf(stderr, "dwm: %-18s %8s %10s %10s %10s\n", "to flush (us)", "count", "p50", "p99", "max");
+	for (i = 0; i < LASTEvent; i++)
+		histprint(evnames[i] ? evnames[i] : "?", &evdone[i]);
+	histprintkeys(keydone);
+	fprintf(stderr, "dwm: %lu XSync in %.0f s, %.2f/s\n", xsyncs,
+		(nowns() - startns) / 1e9, xsyncs / MAX((nowns() - startns) / 1e9, 1.0));
+#ifdef XSTATS
+	fprintf(stderr, "dwm: %-18s %8s %10s %10s %12s %10s\n",
+		"x traffic", "calls", "requests", "roundtrips", "bytes", "configures");
+	for (i = 0; i < StatLast; i++)
+		if (xstats[i].calls)
+			fprintf(stderr, "dwm: %-18s %8lu %10lu %10lu %12lu %10lu\n",
+				i < LASTEvent ? evnames[i] : xstatnames[i - LASTEvent],
+				xstats[i].calls, xstats[i].requests, xstats[i].roundtrips, xstats[i].bytes,
+				xstats[i].configures);
+#endif /* XSTATS */
+}
+
+/* SIGCHLD reaps children, SIGUSR1 dumps the counters to stderr */
+static void
+readsignals(void)
+{
+	struct signalfd_siginfo si;
+
+	while (read(sigfd, &si, sizeof si) == sizeof si)
+		if (si.ssi_signo == SIGUSR1)
+			dumpstats();
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+}
+
+void
+run(void)
+{
+	struct epoll_event events[4];
+	uint64_t expirations;
+	int i, n;
+
+	/* main event loop */
+	XSync(dpy, False);
+	while (running) {
+		/* Xlib may already hold queued events the fd will never announce;
+		 * XPending also flushes our output before we block */
+		if (XPending(dpy)) {
+			dispatchevents();
+			continue;
+		}
+		if ((n = epoll_wait(epfd, events, LENGTH(events), -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("dwm: epoll_wait:");
+		}
+		for (i = 0; i < n; i++) {
+			if (events[i].data.fd == timerfd) {
+				if (read(timerfd, &expirations, sizeof expirations) == sizeof expirations) {
+					drawstatusbar();
+					if (syncwaits)
+						syncexpire();
+				}
+			} else if (events[i].data.fd == animfd) {
+				if (read(animfd, &expirations, sizeof expirations) == sizeof expirations)
+					animatescroll(expirations);
+			} else if (events[i].data.fd == sigfd) {
+				readsignals();
+			}
+			/* X fd readiness is picked up by XPending on the next pass */
+		}
+	}
+}
+
+static void
+setupmainloop(void)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	struct itimerspec its = {
+		.it_interval = { .tv_sec = 1 },
+		.it_value = { .tv_nsec = 1 }, /* first status draw right away */
+	};
+	sigset_t mask;
+
+	/* SIGCHLD and SIGUSR1 arrive on sigfd instead of as async signals */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGUSR1);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0)
+		die("dwm: sigprocmask:");
+	if ((sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+		die("dwm: signalfd:");
+	if ((timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		die("dwm: timerfd_create:");
+	timerfd_settime(timerfd, 0, &its, NULL);
+	if ((animfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		die("dwm: timerfd_create:");
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		die("dwm: epoll_create1:");
+	ev.data.fd = ConnectionNumber(dpy);
+	epoll_ctl(epfd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+	ev.data.fd = timerfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+	ev.data.fd = animfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, animfd, &ev);
+	ev.data.fd = sigfd;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev);
+}
+
+void
+runautostart(void)
+{
+	char *home, *path;
+	sigset_t mask;
+
+	if (!autostartscript || !*autostartscript)
+		return;
 
 	if (!(home = getenv("HOME")))
 		return;
@@ -3412,6 +4676,8 @@ runautostart(void)
 	/* Run script in background */
 	if (access(path, X_OK) == 0) {
 		if (fork() == 0) {
+			sigemptyset(&mask);
+			sigprocmask(SIG_SETMASK, &mask, NULL);
 			execl(path, path, (char *)NULL);
 			_exit(1);
 		}
@@ -3475,9 +4741,9 @@ sendmon(Client *c, Monitor *m)
 		c->floatx = c->floatx - old_scrollx + new_scrollx;
 	}
 	
-	/* reparent client into target monitor container */
+	/* reparent client into target monitor's strip */
 	c->ignoreunmap = 2;
-	XReparentWindow(dpy, c->win, m->container, c->x - m->wx, c->y - m->wy);
+	reparentstrip(c);
 	attach(c);
 	attachstack(c);
 	focus(NULL);
@@ -3607,13 +4873,13 @@ setup(void)
 	int i;
 	XSetWindowAttributes wa;
 	Atom utf8string;
-	struct sigaction sa;
 
-	/* do not transform children into zombies when they terminate */
-	sigemptyset(&sa.sa_mask);
-	sa.sa_flags = SA_NOCLDSTOP | SA_NOCLDWAIT | SA_RESTART;
-	sa.sa_handler = SIG_IGN;
-	sigaction(SIGCHLD, &sa, NULL);
+	/* children are reaped from the main loop via signalfd */
+	setupmainloop();
+	startns = nowns();
+#ifdef XSTATS
+	XESetBeforeFlush(dpy, XAddExtension(dpy)->extension, countflush);
+#endif /* XSTATS */
 
 	/* clean up any zombies (inherited from .xinitrc etc) immediately */
 	while (waitpid(-1, NULL, WNOHANG) > 0);
@@ -3636,19 +4902,9 @@ setup(void)
 	
 	/* 初始化状态栏 */
 	initstatusbar();
-	
-	/* 启动状态栏线程 */
-	pthread_mutex_lock(&statuscache_mutex);
-	status_thread_running = 1;
-	pthread_mutex_unlock(&statuscache_mutex);
-	if (pthread_create(&drawstatusthread, NULL, drawstatusbar, NULL) != 0) {
-		pthread_mutex_lock(&statuscache_mutex);
-		status_thread_running = 0;
-		pthread_mutex_unlock(&statuscache_mutex);
-		die("failed to create status thread");
-	}
-	status_thread_started = 1;
 	initshape();
+	initsync();
+	initxi();
 	initcompositor();
 
 	/* init preview mode from config */
@@ -3675,6 +4931,8 @@ setup(void)
 netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 netatom[NetWMWindowTypeDesktop] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
 netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	netatom[NetWMSyncRequest] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST", False);
+	netatom[NetWMSyncRequestCounter] = XInternAtom(dpy, "_NET_WM_SYNC_REQUEST_COUNTER", False);
 	xatom[Manager] = XInternAtom(dpy, "MANAGER", False);
 	xatom[Xembed] = XInternAtom(dpy, "_XEMBED", False);
 	xatom[XembedInfo] = XInternAtom(dpy, "_XEMBED_INFO", False);
@@ -3781,6 +5039,10 @@ updateborderwin(void)
 {
 	if (!shape_supported)
 		return;
+	if (batching) {
+		borderdirty = 1;
+		return;
+	}
 	if (borderwin == None)
 		setupborderwin();
 	if (borderwin == None)
@@ -3901,15 +5163,29 @@ setwindowrounded(Window win, int w, int h, int r)
 }
 
 static int
-getcornerradius(Window win, XWindowAttributes *wa)
+cornerradiusfor(const char *class, const char *instance, const char *title, int override_redirect)
 {
-	const char *class = NULL, *instance = NULL, *title = NULL;
 	unsigned int i;
 	const CornerRule *r;
-	XClassHint ch = { NULL, NULL };
 
-	/* 默认使用全局圆角半径 */
-	int radius = cornerradius;
+	/* 匹配圆角规则，默认使用全局圆角半径 */
+	for (i = 0; i < LENGTH(cornerrules); i++) {
+		r = &cornerrules[i];
+		if ((r->override_redirect == -1 || r->override_redirect == override_redirect)
+		&& (!r->title || (title && strstr(title, r->title)))
+		&& (!r->class || (class && strstr(class, r->class)))
+		&& (!r->instance || (instance && strstr(instance, r->instance))))
+			return r->radius;
+	}
+	return cornerradius;
+}
+
+static int
+getcornerradius(Window win, XWindowAttributes *wa)
+{
+	const char *class = NULL, *instance = NULL, *title = NULL;
+	XClassHint ch = { NULL, NULL };
+	int radius;
 
 	/* 获取窗口类和实例名 */
 	if (XGetClassHint(dpy, win, &ch)) {
@@ -3922,18 +5198,7 @@ getcornerradius(Window win, XWindowAttributes *wa)
 	if (XFetchName(dpy, win, &winname) && winname)
 		title = winname;
 
-	/* 匹配圆角规则 */
-	for (i = 0; i < LENGTH(cornerrules); i++) {
-		r = &cornerrules[i];
-		if ((r->override_redirect == -1 || r->override_redirect == wa->override_redirect)
-		&& (!r->title || (title && strstr(title, r->title)))
-		&& (!r->class || (class && strstr(class, r->class)))
-		&& (!r->instance || (instance && strstr(instance, r->instance))))
-		{
-			radius = r->radius;
-			break;
-		}
-	}
+	radius = cornerradiusfor(class, instance, title, wa->override_redirect);
 
 	if (ch.res_class)
 		XFree(ch.res_class);
@@ -3949,15 +5214,27 @@ static void
 applyroundedcorners(Window win)
 {
 	XWindowAttributes wa;
+	Client *c;
+	int radius;
 
 	if (!shape_supported || !win)
 		return;
-	if (!XGetWindowAttributes(dpy, win, &wa))
+	if ((c = wintoclient(win))) {
+		/* clients have no border and a shadow of their size */
+		wa.width = c->srv.w;
+		wa.height = c->srv.h;
+		wa.border_width = 0;
+		wa.override_redirect = False;
+		if (c->radius < 0)
+			c->radius = getcornerradius(win, &wa);
+		radius = c->radius;
+	} else if (!XGetWindowAttributes(dpy, win, &wa))
 		return;
+	else
+		radius = getcornerradius(win, &wa);
 
 	int outerw = wa.width + 2 * wa.border_width;
 	int outerh = wa.height + 2 * wa.border_width;
-	int radius = getcornerradius(win, &wa);
 
 	setwindowrounded(win, outerw, outerh, radius);
 }
@@ -3982,123 +5259,409 @@ setroundedfromattrs(Window win, XWindowAttributes *wa)
 void
 showhide(Monitor *m)
 {
-	for (int i = 0; i < LENGTH(tags); i++) {
-		Scroll *s = &m->scrolls[i];
-		int inview = (m->scrollindex == s);
-
-		for (Client *c = s->head; c; c = c->next) {
-			if (inview) {
-				XMoveWindow(dpy, c->win, c->x - m->wx, c->y - m->wy);
-				if (!m->lt[m->sellt]->arrange && !c->isfullscreen)
-					resize(c, c->x, c->y, c->w, c->h, 0);
-			} else {
-				XMoveWindow(dpy, c->win, c->w * -2, c->y);
-			}
+	Scroll *s = m->scrollindex;
+
+	if (!s)
+		return;
+	showstrip(m);
+	for (Client *c = s->head; c; c = c->next) {
+		if (c->parked) {
+			/* scroll() brings parked clients back as they come into view */
+			if (m->lt[m->sellt]->arrange != scroll)
+				resizeclient(c, c->x, c->y, c->w, c->h);
+			continue;
 		}
+		c->stripx = c->x - m->wx + s->x;
+		if (c->srv.x != STRIPX(c) || c->srv.y != c->y - m->wy)
+			movewin(c, STRIPX(c), c->y - m->wy);
+		if (!m->lt[m->sellt]->arrange && !c->isfullscreen)
+			resize(c, c->x, c->y, c->w, c->h, 0);
 	}
 }
 
+/* a tag switch maps one strip and unmaps another, clients on hidden tags
+ * keep their places in their unmapped strips */
+void
+showstrip(Monitor *m)
+{
+	Scroll *s = m->scrollindex;
+
+	if (!s || m->shown == s)
+		return;
+	XMapWindow(dpy, s->strip);
+	if (m->shown)
+		XUnmapWindow(dpy, m->shown->strip);
+	m->shown = s;
+}
+
+/* whether the shown tag's strip still holds its last layout */
+int
+snapshotvalid(Monitor *m)
+{
+	Scroll *s = m->scrollindex;
+
+	return s && m->lt[m->sellt]->arrange == scroll && s->snapgen == s->gen && s->snapx == s->x
+		&& s->snaparea.x == m->wx && s->snaparea.y == m->wy
+		&& s->snaparea.w == m->ww && s->snaparea.h == m->wh;
+}
+
 void
 spawn(const Arg *arg)
 {
-	struct sigaction sa;
+	sigset_t mask;
 
 	if (fork() == 0) {
 		if (dpy)
 			close(ConnectionNumber(dpy));
 		setsid();
 
-		sigemptyset(&sa.sa_mask);
-		sa.sa_flags = 0;
-		sa.sa_handler = SIG_DFL;
-		sigaction(SIGCHLD, &sa, NULL);
+		/* dwm blocks SIGCHLD for its signalfd; do not pass that on */
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+
+		execvp(((char **)arg->v)[0], (char **)arg->v);
+		die("dwm: execvp '%s' failed:", ((char **)arg->v)[0]);
+	}
+}
+
+void
+tag(const Arg *arg)
+{
+	if (!selmon->sel || arg->i < 0 || arg->i >= LENGTH(tags))
+		return;
+
+	Client *c = selmon->sel;
+
+	/* 保存旧的 scroll x 坐标用于调整 floatx */
+	int old_scrollx = (selmon->scrollindex) ? selmon->scrollindex->x : 0;
+	int old_tagindex = c->tagindex;
+
+	detach(selmon->sel);
+	selmon->sel->tagindex = arg->i;
+	attach(selmon->sel);
+	if (old_tagindex != arg->i) {
+		c->ignoreunmap = 2;
+		reparentstrip(c);
+	}
+
+	/* switch view to the new tag */
+	Arg v = { .i = arg->i };
+	view(&v);
+
+	/* 对于 floating 窗口，调整 floatx 以适应新的 scroll x 坐标 */
+	if (c->isfloating && selmon->scrollindex && old_tagindex != arg->i) {
+		int new_scrollx = selmon->scrollindex->x;
+		/* 调整 floatx：减去旧 scroll x，加上新 scroll x */
+		c->floatx = c->floatx - old_scrollx + new_scrollx;
+		
+		/* 更新窗口位置 */
+		resizeclient(c, c->floatx - selmon->scrollindex->x, c->floaty, c->w, c->h);
+		
+		reorderbyx(selmon->scrollindex);
+	}
+}
+
+void
+setdefaultfont(void)
+{
+	drw_setfontset(drw, drw_fontset_create(drw, fonts, LENGTH(fonts)));
+}
+
+
+
+void
+setsmallfont(void)
+{
+	static Fnt *smallfont = NULL;
+	
+	if (!smallfont) {
+		smallfont = drw_fontset_create(drw, &fonts[1], 1);
+		if (!smallfont) return;
+	}
+	
+	drw_setfontset(drw, smallfont);
+}
+
+void
+setstatusdefaultfont(void)
+{
+	if (statusdrw) {
+		drw_setfontset(statusdrw, drw_fontset_create(statusdrw, fonts, LENGTH(fonts)));
+	}
+}
+
+void
+setstatussmallfont(void)
+{
+	static Fnt *status_smallfont = NULL;
+	
+	if (!status_smallfont && statusdrw) {
+		status_smallfont = drw_fontset_create(statusdrw, &fonts[1], 1);
+	}
+	
+	if (statusdrw && status_smallfont) {
+		drw_setfontset(statusdrw, status_smallfont);
+	}
+}
+
+static void
+initshape(void)
+{
+	int evb = 0, erb = 0;
+	shape_supported = XShapeQueryExtension(dpy, &evb, &erb);
+}
+
+static void
+initsync(void)
+{
+	int major = 0, minor = 0;
+
+	sync_supported = XSyncQueryExtension(dpy, &syncevbase, &syncerbase)
+		&& XSyncInitialize(dpy, &major, &minor);
+}
+
+static void
+initxi(void)
+{
+	int ev, err, major = 2, minor = 1;
+
+	if (!XQueryExtension(dpy, "XInputExtension", &xiopcode, &ev, &err)
+	|| XIQueryVersion(dpy, &major, &minor) != Success || major * 10 + minor < 21) {
+		xiopcode = -1;
+		return;
+	}
+	xiscan();
+}
+
+/* the scroll valuators of all slave pointers */
+void
+xiscan(void)
+{
+	XIDeviceInfo *info;
+	XIScrollClassInfo *sc;
+	int i, j, n;
+
+	nxiscroll = 0;
+	if (!(info = XIQueryDevice(dpy, XIAllDevices, &n)))
+		return;
+	for (i = 0; i < n; i++) {
+		if (info[i].use != XISlavePointer)
+			continue;
+		for (j = 0; j < info[i].num_classes && nxiscroll < LENGTH(xiscroll); j++) {
+			sc = (XIScrollClassInfo *)info[i].classes[j];
+			if (sc->type != XIScrollClass || !sc->increment)
+				continue;
+			xiscroll[nxiscroll].dev = info[i].deviceid;
+			xiscroll[nxiscroll].valuator = sc->number;
+			xiscroll[nxiscroll].increment = sc->increment;
+			xiscroll[nxiscroll++].haslast = 0;
+		}
+	}
+	xiseedfrom(info, n);
+	XIFreeDeviceInfo(info);
+}
+
+/* the valuators' current values are where the next deltas start, so the
+ * first wheel click after the scan or an enter counts too */
+static void
+xiseedfrom(XIDeviceInfo *info, int n)
+{
+	XIValuatorClassInfo *vc;
+	int i, j, k;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < info[i].num_classes; j++) {
+			vc = (XIValuatorClassInfo *)info[i].classes[j];
+			if (vc->type != XIValuatorClass)
+				continue;
+			for (k = 0; k < nxiscroll; k++)
+				if (xiscroll[k].dev == info[i].deviceid && xiscroll[k].valuator == vc->number) {
+					xiscroll[k].last = vc->value;
+					xiscroll[k].haslast = 1;
+				}
+		}
+}
+
+void
+xiseed(int deviceid)
+{
+	XIDeviceInfo *info;
+	int n;
+
+	if ((info = XIQueryDevice(dpy, deviceid, &n))) {
+		xiseedfrom(info, n);
+		XIFreeDeviceInfo(info);
+	}
+}
+
+void
+genericevent(XEvent *e)
+{
+	XGenericEventCookie *cookie = &e->xcookie;
+	int i;
+
+	if (cookie->extension != xiopcode || !XGetEventData(dpy, cookie))
+		return;
+	switch (cookie->evtype) {
+	case XI_Motion:
+		ximotion(cookie->data);
+		break;
+	case XI_Enter:
+		/* valuators kept counting while the pointer was elsewhere */
+		for (i = 0; i < nxiscroll; i++)
+			xiscroll[i].haslast = 0;
+		xiseed(((XIEnterEvent *)cookie->data)->sourceid);
+		break;
+	case XI_DeviceChanged:
+		xiscan();
+		break;
+	}
+	XFreeEventData(dpy, cookie);
+}
+
+/* scroll valuator deltas over the bar titles, in wheel clicks, become a
+ * pending pan; the batch applies it once, and with scrollspring set the
+ * pan itself lands at most once per frame */
+void
+ximotion(XIDeviceEvent *ev)
+{
+	double *val = ev->valuators.values, clicks = 0;
+	int i, j;
 
-		execvp(((char **)arg->v)[0], (char **)arg->v);
-		die("dwm: execvp '%s' failed:", ((char **)arg->v)[0]);
+	for (i = 0; i < ev->valuators.mask_len * 8; i++) {
+		if (!XIMaskIsSet(ev->valuators.mask, i))
+			continue;
+		for (j = 0; j < nxiscroll; j++) {
+			if (xiscroll[j].dev != ev->sourceid || xiscroll[j].valuator != i)
+				continue;
+			if (xiscroll[j].haslast)
+				clicks += (*val - xiscroll[j].last) / xiscroll[j].increment;
+			xiscroll[j].last = *val;
+			xiscroll[j].haslast = 1;
+		}
+		val++;
 	}
+	if (clicks)
+		xipan(ev->event, (int)ev->event_x, clicks);
 }
 
 void
-tag(const Arg *arg)
+xipan(Window w, int x, double clicks)
 {
-	if (!selmon->sel || arg->i < 0 || arg->i >= LENGTH(tags))
-		return;
-
-	Client *c = selmon->sel;
-
-	/* 保存旧的 scroll x 坐标用于调整 floatx */
-	int old_scrollx = (selmon->scrollindex) ? selmon->scrollindex->x : 0;
-	int old_tagindex = c->tagindex;
-
-	detach(selmon->sel);
-	selmon->sel->tagindex = arg->i;
-	attach(selmon->sel);
-
-	/* switch view to the new tag */
-	Arg v = { .i = arg->i };
-	view(&v);
+	WinEntry *e = winindexget(&winindex, w);
+	Monitor *m;
+	Arg arg;
 
-	/* 对于 floating 窗口，调整 floatx 以适应新的 scroll x 坐标 */
-	if (c->isfloating && selmon->scrollindex && old_tagindex != arg->i) {
-		int new_scrollx = selmon->scrollindex->x;
-		/* 调整 floatx：减去旧 scroll x，加上新 scroll x */
-		c->floatx = c->floatx - old_scrollx + new_scrollx;
-		
-		/* 更新窗口位置 */
-		resizeclient(c, c->floatx - selmon->scrollindex->x, c->floaty, c->w, c->h);
-		
-		reorderbyx(selmon->scrollindex);
-	}
+	if (!e || e->kind != WinBar)
+		return;
+	m = e->p;
+	if (barclick(m, x, &arg) != ClkWinTitle)
+		return;
+	recordpan(w, x, clicks);
+	m->pendingpan += clicks * smoothscrollpx;
+	if (batching)
+		m->dirty |= DirtyPan;
+	else
+		applypan(m);
 }
 
 void
-setdefaultfont(void)
+applypan(Monitor *m)
 {
-	drw_setfontset(drw, drw_fontset_create(drw, fonts, LENGTH(fonts)));
+	int dx = (int)m->pendingpan;
+
+	m->pendingpan -= dx;
+	if (dx && m->scrollindex)
+		scrollby(m, dx);
 }
 
+/* ask c to bump its counter once it has drawn the configure that follows */
+void
+syncrequest(Client *c)
+{
+	const unsigned long mask = XSyncCACounter|XSyncCAValueType|XSyncCAValue|XSyncCATestType|XSyncCAEvents;
+	XSyncAlarmAttributes aa;
+	XSyncValue v;
+	XEvent ev = { 0 };
+
+	/* continue from wherever the client's counter stands, once */
+	if (!c->syncalarm && XSyncQueryCounter(dpy, c->synccounter, &v))
+		c->syncvalue = syncint(v);
+	c->syncvalue++;
+	aa.trigger.counter = c->synccounter;
+	aa.trigger.value_type = XSyncAbsolute;
+	XSyncIntsToValue(&aa.trigger.wait_value, c->syncvalue & 0xffffffff, (int)(c->syncvalue >> 32));
+	aa.trigger.test_type = XSyncPositiveComparison;
+	aa.events = True;
+	if (c->syncalarm)
+		XSyncChangeAlarm(dpy, c->syncalarm, mask, &aa);
+	else {
+		c->syncalarm = XSyncCreateAlarm(dpy, mask, &aa);
+		winindexadd(&winindex, c->syncalarm, WinSyncAlarm, c);
+	}
 
+	ev.type = ClientMessage;
+	ev.xclient.window = c->win;
+	ev.xclient.message_type = wmatom[WMProtocols];
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = netatom[NetWMSyncRequest];
+	ev.xclient.data.l[1] = CurrentTime;
+	ev.xclient.data.l[2] = c->syncvalue & 0xffffffff;
+	ev.xclient.data.l[3] = c->syncvalue >> 32;
+	XSendEvent(dpy, c->win, False, NoEventMask, &ev);
+	if (!c->syncsent)
+		syncwaits++;
+	c->syncsent = nowns();
+}
 
+/* c caught up (or gave up): send the size held back, if any */
 void
-setsmallfont(void)
+syncdone(Client *c)
 {
-	static Fnt *smallfont = NULL;
-	
-	if (!smallfont) {
-		smallfont = drw_fontset_create(drw, &fonts[1], 1);
-		if (!smallfont) return;
+	if (!c->syncsent)
+		return;
+	c->syncsent = 0;
+	syncwaits--;
+	if (c->syncpending) {
+		c->syncpending = 0;
+		resizeclient(c, c->x, c->y, c->w, c->h);
 	}
-	
-	drw_setfontset(drw, smallfont);
 }
 
+/* clients that never answer are not waited on forever */
 void
-setstatusdefaultfont(void)
+syncexpire(void)
 {
-	if (statusdrw) {
-		drw_setfontset(statusdrw, drw_fontset_create(statusdrw, fonts, LENGTH(fonts)));
-	}
+	uint64_t now = nowns();
+	Monitor *m;
+	Client *c;
+
+	for (m = mons; m; m = m->next)
+		for (c = m->stack; c; c = c->snext)
+			if (c->syncsent && now - c->syncsent >= SYNCTIMEOUT)
+				syncdone(c);
 }
 
-void
-setstatussmallfont(void)
+uint64_t
+syncint(XSyncValue v)
 {
-	static Fnt *status_smallfont = NULL;
-	
-	if (!status_smallfont && statusdrw) {
-		status_smallfont = drw_fontset_create(statusdrw, &fonts[1], 1);
-	}
-	
-	if (statusdrw && status_smallfont) {
-		drw_setfontset(statusdrw, status_smallfont);
-	}
+	return (uint64_t)(uint32_t)XSyncValueHigh32(v) << 32 | XSyncValueLow32(v);
 }
 
-static void
-initshape(void)
+void
+syncalarmnotify(XEvent *e)
 {
-	int evb = 0, erb = 0;
-	shape_supported = XShapeQueryExtension(dpy, &evb, &erb);
+	XSyncAlarmNotifyEvent *ev = (XSyncAlarmNotifyEvent *)e;
+	WinEntry *we = winindexget(&winindex, ev->alarm);
+	Client *c;
+
+	if (!we || we->kind != WinSyncAlarm)
+		return;
+	c = we->p;
+	/* a late answer to a request syncexpire() gave up on is not this one */
+	if (syncint(ev->counter_value) < c->syncvalue)
+		return;
+	syncdone(c);
 }
 
 static void
@@ -4119,7 +5682,9 @@ redirectmonitor(Monitor *m)
 {
 	if (!composite_supported || !m)
 		return;
-	XCompositeRedirectSubwindows(dpy, m->container, CompositeRedirectAutomatic);
+	/* the clients, not the strips: a strip is far too large to back */
+	for (int i = 0; i < LENGTH(tags); i++)
+		XCompositeRedirectSubwindows(dpy, m->scrolls[i].strip, CompositeRedirectAutomatic);
 }
 
 void
@@ -4157,6 +5722,9 @@ synccontainerbg(Monitor *m)
 		XChangeProperty(dpy, m->container, xatom[XRootPmap], XA_PIXMAP, 32,
 			PropModeReplace, (unsigned char *)&pm, 1);
 		XClearWindow(dpy, m->container);
+		/* strips inherit it through ParentRelative */
+		for (int i = 0; i < LENGTH(tags); i++)
+			XClearWindow(dpy, m->scrolls[i].strip);
 	}
 }
 
@@ -4346,6 +5914,13 @@ unmanage(Client *c, int destroyed)
 	Monitor *m = c->mon;
 	XWindowChanges wc;
 
+	winindexdel(&winindex, c->win);
+	if (c->syncalarm) {
+		winindexdel(&winindex, c->syncalarm);
+		XSyncDestroyAlarm(dpy, c->syncalarm);
+	}
+	if (c->syncsent)
+		syncwaits--;
 	detach(c);
 	detachstack(c);
 
@@ -4413,6 +5988,12 @@ updatebars(void)
 		.event_mask = ButtonPressMask|ExposureMask
 	};
 	XClassHint ch = {"dwm", "dwm"};
+	unsigned char mask[XIMaskLen(XI_LASTEVENT)] = { 0 };
+	XIEventMask xim = { XIAllMasterDevices, sizeof mask, mask };
+
+	XISetMask(mask, XI_Motion);
+	XISetMask(mask, XI_Enter);
+	XISetMask(mask, XI_DeviceChanged);
 	for (m = mons; m; m = m->next) {
 		if (m->barwin)
 			continue;
@@ -4422,6 +6003,9 @@ updatebars(void)
 		m->barwin = XCreateWindow(dpy, root, m->wx, m->by, w, bh, 0, DefaultDepth(dpy, screen),
 				CopyFromParent, DefaultVisual(dpy, screen),
 				CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
+		winindexadd(&winindex, m->barwin, WinBar, m);
+		if (xiopcode >= 0)
+			XISelectEvents(dpy, m->barwin, &xim, 1);
 		XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
 		if (showsystray && systray && m == systraytomon(m))
 			XMapRaised(dpy, systray->win);
@@ -4593,7 +6177,7 @@ movelastmonclients(Monitor *src, Monitor *dst, int *dirty)
 			int old_scrollx = src->scrollindex ? src->scrollindex->x : 0;
 
 			*dirty = 1;
-			src->scrolls[t].head = c->next;
+			detach(c);
 			detachstack(c);
 			c->mon = dst;
 
@@ -4603,8 +6187,7 @@ movelastmonclients(Monitor *src, Monitor *dst, int *dirty)
 			}
 
 			c->ignoreunmap = 2;
-			XReparentWindow(dpy, c->win, dst->container,
-			                c->x - dst->wx, c->y - dst->wy);
+			reparentstrip(c);
 			attach(c);
 			attachstack(c);
 		}
@@ -4636,6 +6219,14 @@ updatesizehints(Client *c)
 	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
+	setsizehints(c, &size);
+}
+
+void
+setsizehints(Client *c, XSizeHints *hints)
+{
+	XSizeHints size = *hints;
+
 	if (size.flags & PBaseSize) {
 		c->basew = size.base_width;
 		c->baseh = size.base_height;
@@ -4748,6 +6339,7 @@ updatesystray(void)
 
 	if (!showsystray)
 		return;
+	STATBEGIN();
 	if (!systray) {
 		/* init systray */
 		if (!(systray = (Systray *)calloc(1, sizeof(Systray))))
@@ -4764,12 +6356,12 @@ updatesystray(void)
 		XSetSelectionOwner(dpy, netatom[NetSystemTray], systray->win, CurrentTime);
 		if (XGetSelectionOwner(dpy, netatom[NetSystemTray]) == systray->win) {
 			sendevent(root, xatom[Manager], StructureNotifyMask, CurrentTime, netatom[NetSystemTray], systray->win, 0, 0);
-			XSync(dpy, False);
 		}
 		else {
 			fprintf(stderr, "dwm: unable to obtain system tray.\n");
 			free(systray);
 			systray = NULL;
+			STATEND(StatSystray);
 			return;
 		}
 	}
@@ -4806,10 +6398,10 @@ updatesystray(void)
 	/* redraw background */
 	XSetForeground(dpy, drw->gc, scheme[SchemeNorm][ColBg].pixel);
 	XFillRectangle(dpy, systray->win, drw->gc, 0, 0, w, bh);
-	XSync(dpy, False);
 	/* now that tray moved, resize bars so drawbar maps correct width */
 	for (Monitor *mm = mons; mm; mm = mm->next)
 		resizebarwin(mm);
+	STATEND(StatSystray);
 }
 
 void
@@ -4824,9 +6416,13 @@ updatetitle(Client *c)
 void
 updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
+	setwindowtype(c, getatomprop(c, netatom[NetWMState]),
+		getatomprop(c, netatom[NetWMWindowType]));
+}
 
+void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
 	if (state == netatom[NetWMFullscreen])
 		setfullscreen(c, 1);
 	if (wtype == netatom[NetWMWindowTypeDialog])
@@ -4839,19 +6435,25 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
 
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else
+		c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
 void
 view(const Arg *arg)
 {
@@ -4871,7 +6473,15 @@ view(const Arg *arg)
 	
 	if (arg->i >= 0 && arg->i < LENGTH(tags))
 		selmon->scrollindex = &selmon->scrolls[arg->i];
+	/* before focus: windows in an unmapped strip cannot take it */
+	showstrip(selmon);
 	focus(NULL);
+	/* nothing on the tag changed while it was hidden: show it as it was */
+	if (snapshotvalid(selmon)) {
+		enterserial = NextRequest(dpy);
+		XNoOp(dpy);
+		return;
+	}
 	arrange(selmon);
 }
 
@@ -4889,41 +6499,35 @@ viewlast(const Arg *arg)
 Client *
 wintoclient(Window w)
 {
-	Client *c;
-	Monitor *m;
+	WinEntry *e = winindexget(&winindex, w);
 
-	for (m = mons; m; m = m->next)
-		for (int i = 0; i < LENGTH(tags); i++)
-			for (c = m->scrolls[i].head; c; c = c->next)
-				if (c->win == w)
-					return c;
-	return NULL;
+	return (e && e->kind == WinClient) ? e->p : NULL;
 }
 
 Client *
 wintosystrayicon(Window w) {
-	Client *i = NULL;
+	WinEntry *e;
 
 	if (!showsystray || !systray || !w)
-		return i;
-	for (i = systray->icons; i && i->win != w; i = i->next) ;
-	return i;
+		return NULL;
+	e = winindexget(&winindex, w);
+	return (e && e->kind == WinSystrayIcon) ? e->p : NULL;
 }
 
 Monitor *
 wintomon(Window w)
 {
 	int x, y;
-	Client *c;
-	Monitor *m;
+	WinEntry *e;
 
 	if (w == root && getrootptr(&x, &y))
 		return recttomon(x, y, 1, 1);
-	for (m = mons; m; m = m->next)
-		if (w == m->barwin)
-			return m;
-	if ((c = wintoclient(w)))
-		return c->mon;
+	if ((e = winindexget(&winindex, w))) {
+		if (e->kind == WinBar || e->kind == WinContainer || e->kind == WinStrip)
+			return e->p;
+		if (e->kind == WinClient)
+			return ((Client *)e->p)->mon;
+	}
 	return selmon;
 }
 
@@ -4953,7 +6557,10 @@ xerror(Display *dpy, XErrorEvent *ee)
 	|| (ee->request_code == X_ConfigureWindow && ee->error_code == BadMatch)
 	|| (ee->request_code == X_GrabButton && ee->error_code == BadAccess)
 	|| (ee->request_code == X_GrabKey && ee->error_code == BadAccess)
-	|| (ee->request_code == X_CopyArea && ee->error_code == BadDrawable))
+	|| (ee->request_code == X_CopyArea && ee->error_code == BadDrawable)
+	/* clients destroy their sync counter before their window on exit */
+	|| (sync_supported && (ee->error_code == syncerbase + XSyncBadCounter
+	                    || ee->error_code == syncerbase + XSyncBadAlarm)))
 		return 0;
 
 	/* 对于其他错误，使用 dunstify 通知而不是直接退出 */
@@ -5010,89 +6617,280 @@ togglesupericon(const Arg *arg)
 
 
 
+/* every arrange() reruns the layout, but a pan or an mfact change moves only
+ * part of the strip: skip the X requests for clients that stay put */
 void
-scroll(Monitor *m)
+placeclient(Client *c, int x, int y, int w, int h)
+{
+	Monitor *m = c->mon;
+	Scroll *s = &m->scrolls[c->tagindex];
+
+	/* a pan leaves strip positions alone, only the screen x moves */
+	if (!c->parked && c->stripx == x - m->wx + s->x
+	&& c->y == y && c->w == w && c->h == h) {
+		c->x = x;
+		c->floatx = x + s->x;
+		return;
+	}
+	/* clients outside the viewport are parked once and then only tracked */
+	if (x + w <= m->wx - cullmargin || x >= m->wx + m->ww + cullmargin) {
+		parkclient(c);
+		c->x = x;
+		c->y = y;
+		c->w = w;
+		c->h = h;
+		c->floatx = x + s->x;
+		c->floaty = y;
+		return;
+	}
+	resizeclient(c, x, y, w, h);
+}
+
+/* put c into the strip of its tag; callers set ignoreunmap if it is mapped */
+void
+reparentstrip(Client *c)
 {
+	Scroll *s = &c->mon->scrolls[c->tagindex];
+
+	int x;
+
+	c->stripx = c->x - c->mon->wx + s->x;
+	x = STRIPX(c);
+	c->parked = !INSTRIP(x);
+	if (c->parked)
+		x = -2 * c->w;
+	setshadow(c, x, c->y - c->mon->wy, c->w, c->h);
+	XReparentWindow(dpy, c->win, s->strip, x, c->y - c->mon->wy);
+}
+
+/* move c off screen, its geometry is then only tracked */
+void
+parkclient(Client *c)
+{
+	if (!c->parked)
+		movewin(c, -2 * c->w, c->y - c->mon->wy);
+	c->parked = 1;
+}
+
+/* record the geometry the next request gives c->win */
+void
+setshadow(Client *c, int x, int y, int w, int h)
+{
+	c->srv = (Rect){ x, y, w, h };
+	c->srvserial = NextRequest(dpy);
+#ifdef XSTATS
+	xconfigures++;
+#endif /* XSTATS */
+}
+
+void
+movewin(Client *c, int x, int y)
+{
+	setshadow(c, x, y, c->srv.w, c->srv.h);
+	XMoveWindow(dpy, c->win, x, y);
+}
+
+/* clients that rode along with a pan learn their new root position */
+void
+configurestrip(Monitor *m)
+{
+	Scroll *s = m->scrollindex;
 	Client *c;
-	int n = 0;
-	int x, w;
-	int h = 0, y = 0;
+	int i;
 
-	if (!m->scrollindex)
+	if (batching) {
+		m->dirty |= DirtyNotify;
 		return;
+	}
+	indexstrip(s);
+	for (i = 0; i < s->nfloating; i++) {
+		c = s->floating[i];
+		if (!c->parked && c->x + c->w > m->wx && c->x < m->wx + m->ww)
+			configure(c);
+	}
+	/* tiled clients from the first visible one to the right screen edge */
+	for (i = tiledat(s, s->x); i < s->ntiled && s->tiledx[i] < s->x + m->ww; i++) {
+		c = s->tiled[i];
+		if (!c->parked && c->x + c->w > m->wx && c->x < m->wx + m->ww)
+			configure(c);
+	}
+}
 
-	/* Place floating clients relative to scroll offset (ignore fullscreen) */
-	for (c = m->scrollindex->head; c; c = c->next) {
-		if (!c->isfloating || c->isfullscreen)
+/* rebuild the index of s from its list, if the list changed since */
+void
+indexstrip(Scroll *s)
+{
+	Client *c;
+	int n = 0, x = scrollstartgap;
+
+	if (s->indexed)
+		return;
+	for (c = s->head; c; c = c->next)
+		n++;
+	if (n + 1 > s->cap) {
+		s->cap = MAX(n + 1, 2 * s->cap);
+		free(s->all);
+		free(s->tiled);
+		free(s->floating);
+		free(s->tiledx);
+		s->all = ecalloc(s->cap, sizeof(Client *));
+		s->tiled = ecalloc(s->cap, sizeof(Client *));
+		s->floating = ecalloc(s->cap, sizeof(Client *));
+		s->tiledx = ecalloc(s->cap, sizeof(int));
+	}
+	s->nall = s->ntiled = s->nfloating = 0;
+	for (c = s->head; c; c = c->next) {
+		c->index = s->nall;
+		c->rank = s->ntiled;
+		s->all[s->nall++] = c;
+		if (c->isfloating) {
+			s->floating[s->nfloating++] = c;
 			continue;
-		resizeclient(c, c->floatx - m->scrollindex->x, c->floaty, c->w, c->h);
+		}
+		s->tiledx[s->ntiled] = x;
+		s->tiled[s->ntiled++] = c;
+		x += c->w + gappx;
 	}
+	s->tiledx[s->ntiled] = x;
+	s->indexed = 1;
+}
 
-	/* Count clients in the current scrollindex's scroll list */
-	for (c = m->scrollindex->head; c; c = c->next)
-		if (!c->isfloating)
-			n++;
-	
-	if (n == 0)
+/* the shown tag's index with any pending layout applied */
+Scroll *
+stripindex(Monitor *m)
+{
+	syncarrange(m);
+	indexstrip(m->scrollindex);
+	return m->scrollindex;
+}
+
+/* rank of the tiled client whose slot starts at or left of strip x px */
+int
+tiledat(Scroll *s, int px)
+{
+	int lo = 0, hi = s->ntiled, mid;
+
+	while (hi - lo > 1) {
+		mid = (lo + hi) / 2;
+		if (s->tiledx[mid] <= px)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* the scroll layout of m's shown strip at its pan, one Rect per client in
+ * list order; valid until the next call */
+Rect *
+layoutstrip(Monitor *m)
+{
+	static LayoutClient *lc;
+	static Rect *r;
+	static int cap;
+	const ScrollGaps g = { gappx, scrollstartgap, bh };
+	Scroll *s = m->scrollindex;
+	Client *c;
+	int i, n = 0;
+
+	for (c = s->head; c; c = c->next)
+		n++;
+	if (n > cap) {
+		cap = MAX(n, 2 * cap);
+		free(lc);
+		free(r);
+		lc = ecalloc(cap, sizeof(LayoutClient));
+		r = ecalloc(cap, sizeof(Rect));
+	}
+	for (i = 0, c = s->head; c; c = c->next, i++)
+		lc[i] = (LayoutClient){ c->mfact, c->isfloating, c->isfullscreen,
+		                        c->floatx, c->floaty, c->w, c->h };
+	layout_scroll(lc, n, (Rect){ m->wx, m->wy, m->ww, m->wh }, s->x, &g, r);
+	return r;
+}
+
+/* pan to a window that is about to be mapped before anything is placed, so
+ * the layout that follows configures every client once, where it ends up */
+void
+revealnew(Client *c)
+{
+	Monitor *m = c->mon;
+	Scroll *s = m->scrollindex;
+	Rect r;
+	int dx, dy;
+
+	if (!s || m->lt[m->sellt]->arrange != scroll)
 		return;
+	indexstrip(s);
+	r = layoutstrip(m)[c->index];
+	if (!layout_reveal(r, (Rect){ m->wx, m->wy, m->ww, m->wh },
+	                   gappx, scrollstartgap, r.w, 50, c->isfloating, &dx, &dy))
+		return;
+	/* jump, an eased pan would slide the new window in; a running one
+	 * sees the strip moved and stops */
+	s->x = MAX(s->x + dx, 0);
+	c->floaty += dy;
+}
 
-	/* single client special handling */
-	if (n == 1) {
-		for (c = m->scrollindex->head; c; c = c->next) {
-			if (c->isfloating)
-				continue;
+void
+scroll(Monitor *m)
+{
+	Scroll *s = m->scrollindex;
+	Client *c;
+	Rect *r;
+	int i, panned, rebased;
 
-			if (c->mfact >= 0.95f) {
-				/* fill mode: window fills the screen with gaps */
-				x = m->wx + gappx;
-				w = m->ww - 2 * gappx;
-				if (w < 100)
-					w = 100;
-				h = m->wh - 2 * scrollstartgap;
-				y = m->wy + scrollstartgap;
-			} else {
-				/* centered mode: width controlled by mfact */
-				int topgap = 30;
-				int bottomgap = 60;
-
-				h = m->wh - topgap - bottomgap;
-				if (h < 100)
-					h = 100;
-				if (h > m->wh - 2 * scrollstartgap)
-					h = m->wh - 2 * scrollstartgap;
-
-				w = m->ww * c->mfact;
-				if (w < 100)
-					w = 100;
-
-				y = m->wy + topgap;
-				x = m->wx + (m->ww - w) / 2;
-			}
-			resizeclient(c, x, y, w, h);
-			return;
+	if (!s)
+		return;
+
+	/* near an edge of the strip window: recentre it on the viewport and
+	 * move the realized clients, the rest are parked and follow on demand */
+	rebased = s->x < s->origin || s->x + m->ww > s->origin + STRIPSIZE;
+	if (rebased) {
+		s->origin = s->x - (STRIPSIZE - m->ww) / 2;
+		for (c = s->head; c; c = c->next) {
+			if (c->parked)
+				continue;
+			if (INSTRIP(STRIPX(c)))
+				movewin(c, STRIPX(c), c->y - m->wy);
+			else
+				parkclient(c);
 		}
 	}
+	/* a pan is one move of the strip window */
+	panned = rebased || s->stripx != s->x;
+	if (panned) {
+		s->stripx = s->x;
+		XMoveWindow(dpy, s->strip, s->origin - s->x, 0);
+	}
 
-	x = m->wx - m->scrollindex->x + scrollstartgap;
-	for (c = m->scrollindex->head; c; c = c->next) {
-		if (c->isfloating)
-			continue;
-
-		/* multi-client layout: height fills window area, width from per-client mfact */
-		h = m->wh - 2 * scrollstartgap;
-		if (h < bh)
-			h = bh;
+	r = layoutstrip(m);
 
-		int layoutw = m->ww * c->mfact;
-		if (layoutw < 100)
-			layoutw = 100;
-		if (layoutw > m->ww - 2 * gappx)
-			layoutw = m->ww - 2 * gappx;
+	/* floating clients first; fullscreen ones stay on the monitor, so they
+	 * move against the strip */
+	for (i = 0, c = s->head; c; c = c->next, i++) {
+		if (c->isfullscreen && c->stripx != c->x - m->wx + s->x) {
+			c->stripx = c->x - m->wx + s->x;
+			movewin(c, STRIPX(c), c->y - m->wy);
+		}
+		if (c->isfloating && !c->isfullscreen)
+			placeclient(c, r[i].x, r[i].y, r[i].w, r[i].h);
+	}
+	for (i = 0, c = s->head; c; c = c->next, i++)
+		if (!c->isfloating)
+			placeclient(c, r[i].x, r[i].y, r[i].w, r[i].h);
 
-		y = m->wy + scrollstartgap;
-		resizeclient(c, x, y, layoutw, h);
-		x += layoutw + gappx;
+	/* widths or floating state may have changed with the layout */
+	s->indexed = 0;
+	indexstrip(s);
+	if (panned) {
+		configurestrip(m);
+		if (m == selmon)
+			updateborderwin();
 	}
+	s->snapgen = s->gen;
+	s->snaparea = (Rect){ m->wx, m->wy, m->ww, m->wh };
+	s->snapx = s->x;
 }
 
 
@@ -5116,15 +6914,89 @@ setmfact(const Arg *arg)
 void
 scrollmove(const Arg *arg)
 {
-	Scroll *s = selmon->scrollindex;
-	if (!s)
+	if (!selmon->scrollindex)
 		return;
+	scrollby(selmon, arg->i);
+}
 
-	s->x += arg->i;
-	if (s->x < 0)
-		s->x = 0;
+/* pan the shown strip of m by dx, eased over the next frames */
+void
+scrollby(Monitor *m, int dx)
+{
+	Scroll *s = m->scrollindex;
 
-	scroll(selmon);
+	if (scrollspring <= 0 || animfd < 0) {
+		s->x = MAX(s->x + dx, 0);
+		scroll(m);
+		return;
+	}
+	/* start from wherever something else may have put the strip */
+	if (!s->animating || s->x != s->animx) {
+		s->pos = s->target = s->animx = s->x;
+		s->vel = 0;
+	}
+	/* wheel clicks between two frames only move the target */
+	s->target = MAX(s->target + dx, 0);
+	if (!s->animating) {
+		s->animating = 1;
+		armanim(1);
+	}
+}
+
+/* one frame of every running pan: a critically damped spring toward the
+ * target, then a single layout per monitor */
+void
+animatescroll(uint64_t frames)
+{
+	const float dt = 1.0f / refreshrate, w = scrollspring;
+	int i, active = 0;
+	Monitor *m;
+	Scroll *s;
+
+	/* catch up on missed frames, but lay out once */
+	frames = MIN(frames, 4);
+	for (m = mons; m; m = m->next) {
+		for (i = 0; i < LENGTH(tags); i++) {
+			s = &m->scrolls[i];
+			if (!s->animating)
+				continue;
+			/* moved by someone else, or its tag went away: stop */
+			if (s->x != s->animx || s != m->scrollindex) {
+				s->animating = 0;
+				if (s->x == s->animx)
+					s->x = s->target;
+				continue;
+			}
+			for (uint64_t f = 0; f < frames; f++) {
+				s->vel += (w * w * (s->target - s->pos) - 2 * w * s->vel) * dt;
+				s->pos += s->vel * dt;
+			}
+			if (ABS(s->target - s->pos) < 0.5f && ABS(s->vel) < 10.0f) {
+				s->pos = s->target;
+				s->animating = 0;
+			}
+			s->x = s->animx = MAX((int)(s->pos + 0.5f), 0);
+			scroll(m);
+			active |= s->animating;
+		}
+	}
+	/* windows sliding under a still pointer are not the user moving it */
+	enterserial = NextRequest(dpy);
+	XNoOp(dpy);
+	if (!active)
+		armanim(0);
+}
+
+void
+armanim(int on)
+{
+	struct itimerspec its = { 0 };
+
+	if (on) {
+		its.it_interval.tv_nsec = 1000000000L / refreshrate;
+		its.it_value = its.it_interval;
+	}
+	timerfd_settime(animfd, 0, &its, NULL);
 }
 
 void
@@ -5861,16 +7733,8 @@ initstatusbar(void)
 }
 
 void
-cleanstatuspthread(void)
+cleanstatusbar(void)
 {
-  if (status_thread_started) {
-    pthread_mutex_lock(&statuscache_mutex);
-    status_thread_running = 0;
-    pthread_mutex_unlock(&statuscache_mutex);
-    pthread_join(drawstatusthread, NULL);
-    status_thread_started = 0;
-  }
-
   /* Free memory */
   if (storagecores.curr) {
     free(storagecores.curr);
@@ -5905,8 +7769,6 @@ updatestatuscache(void)
   if (!selmon)
     return;
 
-  pthread_mutex_lock(&statuscache_mutex);
-
   /* Update global dimensions */
   systrayw = getsystraywidth();
   systandstat = getstatuswidth() + systrayw;
@@ -5921,10 +7783,8 @@ updatestatuscache(void)
     cachew = systandstat;
     cacheh = bh;
     statuscache = XCreatePixmap(dpy, root, cachew, cacheh, DefaultDepth(dpy, screen));
-    if (statuscache == None) {
-      pthread_mutex_unlock(&statuscache_mutex);
+    if (statuscache == None)
       return;
-    }
   }
 
   /* Draw status to cache */
@@ -5938,61 +7798,31 @@ updatestatuscache(void)
 
   drw_map(statusdrw, statuscache, 0, 0, cachew, bh);
   cachevalid = 1;
-  time(&lastupdate);
-  pthread_mutex_unlock(&statuscache_mutex);
 }
 
 void
 freestatuscache(void)
 {
-  pthread_mutex_lock(&statuscache_mutex);
   if (statuscache != None) {
     XFreePixmap(dpy, statuscache);
     statuscache = None;
   }
   cachevalid = 0;
-  pthread_mutex_unlock(&statuscache_mutex);
 }
 
-void *
-drawstatusbar(void *arg)
+/* called from the main loop on every timerfd tick */
+void
+drawstatusbar(void)
 {
-  (void)arg;
-  time_t now;
-
-  while (1) {
-    int keep_running = 0;
-    pthread_mutex_lock(&statuscache_mutex);
-    keep_running = status_thread_running;
-    pthread_mutex_unlock(&statuscache_mutex);
-    if (!keep_running)
-      break;
-
-    if (selmon) {
-      int needs_update = 0;
-      time(&now);
-      pthread_mutex_lock(&statuscache_mutex);
-      needs_update = (!cachevalid || (now - lastupdate) >= 1);
-      pthread_mutex_unlock(&statuscache_mutex);
-
-      /* Only update cache if needed (invalid or 1s passed) */
-      if (needs_update) {
-        updatestatuscache();
-      }
-      
-      /* Copy cache to barwin if available */
-      pthread_mutex_lock(&statuscache_mutex);
-      if (cachevalid && statuscache != None) {
-        XCopyArea(dpy, statuscache, selmon->barwin, statusdrw->gc, 
-                  0, 0, cachew, bh,
-                  selmon->ww - cachew, 0);
-      }
-      pthread_mutex_unlock(&statuscache_mutex);
-    }
+  if (!selmon)
+    return;
 
-    sleep(1);
+  updatestatuscache();
+  if (cachevalid && statuscache != None) {
+    XCopyArea(dpy, statuscache, selmon->barwin, statusdrw->gc,
+              0, 0, cachew, bh,
+              selmon->ww - cachew, 0);
   }
-  return NULL;
 }
 
 void
@@ -6038,14 +7868,20 @@ handleStatus5(const Arg *arg)
 int
 main(int argc, char *argv[])
 {
+	const char *replaypath = NULL;
+	int fast = 0;
+
 	if (argc == 2 && !strcmp("-v", argv[1]))
 		die("dwm-"VERSION);
-	else if (argc != 1)
-		die("usage: dwm [-v]");
+	else if (argc == 3 && !strcmp("-R", argv[1]))
+		recordopen(argv[2]);
+	else if (argc == 3 && (!strcmp("-P", argv[1]) || !strcmp("-F", argv[1]))) {
+		replaypath = argv[2];
+		fast = argv[1][1] == 'F';
+	} else if (argc != 1)
+		die("usage: dwm [-v] [-R file | -P file | -F file]");
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
-	if (!XInitThreads())
-		die("dwm: XInitThreads failed");
 	if (!(dpy = XOpenDisplay(NULL)))
 		die("dwm: cannot open display");
 	checkotherwm();
@@ -6055,8 +7891,13 @@ main(int argc, char *argv[])
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan();
-	runautostart();
-	run();
+	if (replaypath) {
+		replay(replaypath, fast);
+	} else {
+		recordclients();
+		runautostart();
+		run();
+	}
 	cleanup();
 	XCloseDisplay(dpy);
 	return EXIT_SUCCESS;
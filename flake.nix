@@ -33,12 +33,17 @@
         buildInputs = with pkgs; [
           # X11 库
           xorg.libX11
+          xorg.libxcb
           xorg.libXft
           xorg.libXinerama
           xorg.libXrender
           xorg.libXcomposite
           xorg.libXext
+          xorg.libXi
           xorg.libXcursor
+          xorg.libXtst
+          xorg.libXdamage
+          xorg.libXfixes
 
           # 字体相关
           fontconfig
@@ -49,7 +54,7 @@
           gnumake
 
           # 测试工具
-          xorg.xorgserver  # 包含 Xephyr 虚拟显示器
+          xorg.xorgserver  # 包含 Xephyr 与 Xvfb 虚拟显示器
           dwmTest
         ];
 
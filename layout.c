@@ -0,0 +1,254 @@
+/* See LICENSE file for copyright and license details. */
+#include <stddef.h>
+
+#include "layout.h"
+#include "util.h"
+
+/* tiled clients side by side from the strip start, floating ones at their
+ * strip position; r[i] is in screen coordinates for area at pan scrollx.
+ * Fullscreen clients get their floating rectangle, the caller pins them. */
+void
+layout_scroll(const LayoutClient *c, int n, Rect area, int scrollx, const ScrollGaps *g, Rect *r)
+{
+	int i, x, w, h, ntiled = 0;
+
+	for (i = 0; i < n; i++) {
+		r[i].x = c[i].floatx - scrollx;
+		r[i].y = c[i].floaty;
+		r[i].w = c[i].w;
+		r[i].h = c[i].h;
+		if (!c[i].isfloating)
+			ntiled++;
+	}
+	if (ntiled == 0)
+		return;
+
+	/* single client special handling */
+	if (ntiled == 1) {
+		for (i = 0; c[i].isfloating; i++);
+		if (c[i].mfact >= 0.95f) {
+			/* fill mode: window fills the screen with gaps */
+			r[i].x = area.x + g->gap;
+			r[i].w = MAX(area.w - 2 * g->gap, 100);
+			r[i].h = area.h - 2 * g->startgap;
+			r[i].y = area.y + g->startgap;
+		} else {
+			/* centered mode: width controlled by mfact */
+			int topgap = 30;
+			int bottomgap = 60;
+
+			h = MAX(area.h - topgap - bottomgap, 100);
+			r[i].h = MIN(h, area.h - 2 * g->startgap);
+			r[i].w = w = MAX((int)(area.w * c[i].mfact), 100);
+			r[i].y = area.y + topgap;
+			r[i].x = area.x + (area.w - w) / 2;
+		}
+		return;
+	}
+
+	/* height fills the area, width from per-client mfact */
+	h = MAX(area.h - 2 * g->startgap, g->minh);
+	x = area.x - scrollx + g->startgap;
+	for (i = 0; i < n; i++) {
+		if (c[i].isfloating)
+			continue;
+		w = MAX((int)(area.w * c[i].mfact), 100);
+		w = MIN(w, area.w - 2 * g->gap);
+		r[i].x = x;
+		r[i].y = area.y + g->startgap;
+		r[i].w = w;
+		r[i].h = h;
+		x += w + g->gap;
+	}
+}
+
+/* pan (*dx) and, for floating clients, vertical move (*dy) that bring at
+ * least minw x minh of c into area shrunk by the gaps; 0 if it already shows */
+int
+layout_reveal(Rect c, Rect area, int gap, int startgap, int minw, int minh, int isfloating, int *dx, int *dy)
+{
+	int left = area.x + gap, right = area.x + area.w - gap;
+	int top = area.y + startgap + gap, bottom = area.y + area.h - startgap - gap;
+	int visw, vish, shortage, d;
+
+	*dx = *dy = 0;
+	minw = MIN(MAX(minw, 1), c.w);
+	minh = MIN(minh, c.h);
+	visw = MIN(c.x + c.w, right) - MAX(c.x, left);
+	vish = MIN(c.y + c.h, bottom) - MAX(c.y, top);
+	if (visw >= minw && vish >= minh)
+		return 0;
+
+	if (c.x < left)
+		*dx = c.x - left;
+	else if (c.x + minw > right)
+		*dx = c.x + minw - right;
+	else if (c.x + c.w > right)
+		*dx = c.x + c.w - right;
+
+	if (vish < minh && isfloating) {
+		shortage = minh - vish;
+		if (c.y < top && c.y + c.h <= bottom) {
+			d = MIN(shortage, bottom - c.y - c.h);
+			*dy = MAX(d, 0);
+		} else if (c.y + c.h > bottom && c.y >= top) {
+			d = MIN(shortage, c.y - top);
+			*dy = -MAX(d, 0);
+		} else {
+			/* fallback: clamp to viewport band */
+			d = MAX(c.y, top);
+			if (d + minh > bottom)
+				d = bottom - minh;
+			*dy = d - c.y;
+		}
+	}
+	return *dx || *dy;
+}
+
+/* keep r reachable inside bound (the screen while the user drags, the
+ * monitor's window area otherwise) and apply the size hints, if any;
+ * returns whether r differs from cur */
+int
+layout_sizehints(Rect *r, Rect cur, Rect bound, int interact, int minsize, const Hints *hints)
+{
+	int baseismin;
+
+	/* set minimum possible */
+	r->w = MAX(1, r->w);
+	r->h = MAX(1, r->h);
+	if (interact) {
+		if (r->x > bound.x + bound.w)
+			r->x = bound.x + bound.w - cur.w;
+		if (r->y > bound.y + bound.h)
+			r->y = bound.y + bound.h - cur.h;
+		if (r->x + r->w < bound.x)
+			r->x = bound.x;
+		if (r->y + r->h < bound.y)
+			r->y = bound.y;
+	} else {
+		if (r->x >= bound.x + bound.w)
+			r->x = bound.x + bound.w - cur.w;
+		if (r->y >= bound.y + bound.h)
+			r->y = bound.y + bound.h - cur.h;
+		if (r->x + r->w <= bound.x)
+			r->x = bound.x;
+		if (r->y + r->h <= bound.y)
+			r->y = bound.y;
+	}
+	if (r->h < minsize)
+		r->h = minsize;
+	if (r->w < minsize)
+		r->w = minsize;
+	if (hints) {
+		/* see last two sentences in ICCCM 4.1.2.3 */
+		baseismin = hints->basew == hints->minw && hints->baseh == hints->minh;
+		if (!baseismin) { /* temporarily remove base dimensions */
+			r->w -= hints->basew;
+			r->h -= hints->baseh;
+		}
+		/* adjust for aspect limits */
+		if (hints->mina > 0 && hints->maxa > 0) {
+			if (hints->maxa < (float)r->w / r->h)
+				r->w = r->h * hints->maxa + 0.5;
+			else if (hints->mina < (float)r->h / r->w)
+				r->h = r->w * hints->mina + 0.5;
+		}
+		if (baseismin) { /* increment calculation requires this */
+			r->w -= hints->basew;
+			r->h -= hints->baseh;
+		}
+		/* adjust for increment value */
+		if (hints->incw)
+			r->w -= r->w % hints->incw;
+		if (hints->inch)
+			r->h -= r->h % hints->inch;
+		/* restore base dimensions */
+		r->w = MAX(r->w + hints->basew, hints->minw);
+		r->h = MAX(r->h + hints->baseh, hints->minh);
+		if (hints->maxw)
+			r->w = MIN(r->w, hints->maxw);
+		if (hints->maxh)
+			r->h = MIN(r->h, hints->maxh);
+	}
+	return r->x != cur.x || r->y != cur.y || r->w != cur.w || r->h != cur.h;
+}
+
+/* rows of r[i].w x r[i].h boxes, each row centred in gridw and the whole
+ * grid centred in gridh when it fits; sets r[i].x and r[i].y */
+void
+layout_grid(Rect *r, int n, int pad, int gridw, int gridh, int *totalw, int *totalh)
+{
+	int i, j, idx, cols, rows, cx, cy, rowh, roww, start, maxh, maxw;
+
+	if (n <= 0)
+		return;
+	if (n == 1) {
+		r[0].x = (gridw - r[0].w) / 2;
+		r[0].y = (gridh - r[0].h) / 2;
+		if (totalh) *totalh = r[0].h;
+		if (totalw) *totalw = r[0].w;
+		return;
+	}
+
+	if (n <= 4) {
+		roww = pad * (n - 1);
+		maxh = 0;
+		for (i = 0; i < n; i++) {
+			roww += r[i].w;
+			maxh = MAX(maxh, r[i].h);
+		}
+		cx = (gridw - roww) / 2;
+		cy = (gridh - maxh) / 2;
+		for (i = 0; i < n; i++) {
+			r[i].x = cx;
+			r[i].y = cy + (maxh - r[i].h) / 2;
+			cx += r[i].w + pad;
+		}
+		if (totalh) *totalh = maxh;
+		if (totalw) *totalw = roww;
+		return;
+	}
+
+	for (cols = 0; cols <= n / 2; cols++)
+		if (cols * cols >= n)
+			break;
+	rows = (cols && (cols - 1) * cols >= n) ? cols - 1 : cols;
+
+	/* narrow the grid until the first row fits */
+	while (cols > 1) {
+		roww = (cols - 1) * pad;
+		for (i = 0; i < cols && i < n; i++)
+			roww += r[i].w;
+		if (roww <= gridw)
+			break;
+		cols--;
+		rows = (n + cols - 1) / cols;
+	}
+
+	idx = cy = maxh = maxw = 0;
+	for (i = 0; i < rows; i++) {
+		cx = rowh = 0;
+		start = idx;
+		for (j = 0; j < cols && idx < n; j++, idx++) {
+			r[idx].x = cx;
+			rowh = MAX(rowh, r[idx].h);
+			maxw = MAX(maxw, r[idx].w);
+			cx += r[idx].w + pad;
+		}
+		cx = (gridw - (cx - pad)) / 2;
+		for (; start < idx; start++) {
+			r[start].x += cx;
+			r[start].y = cy;
+		}
+		cy += rowh + pad;
+		maxh = MAX(maxh, rowh);
+	}
+
+	if (totalh) *totalh = cy - pad;
+	if (totalw) *totalw = maxw;
+
+	/* centre vertically */
+	if (cy - pad < gridh)
+		for (i = 0; i < n; i++)
+			r[i].y += (gridh - (cy - pad)) / 2;
+}
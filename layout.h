@@ -0,0 +1,32 @@
+/* See LICENSE file for copyright and license details. */
+
+/* Geometry only: nothing here talks to the X server or reads dwm's globals,
+ * so layoutbench can run it without a display. */
+
+typedef struct {
+	int x, y, w, h;
+} Rect;
+
+/* a client as the scroll layout sees it */
+typedef struct {
+	float mfact;
+	int isfloating, isfullscreen;
+	int floatx, floaty, w, h; /* floating clients keep strip position and size */
+} LayoutClient;
+
+/* WM_NORMAL_HINTS as dwm keeps them in a Client */
+typedef struct {
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+	float mina, maxa;
+} Hints;
+
+typedef struct {
+	int gap;      /* gappx */
+	int startgap; /* scrollstartgap */
+	int minh;     /* tiled clients are never shorter (bar height) */
+} ScrollGaps;
+
+void layout_scroll(const LayoutClient *c, int n, Rect area, int scrollx, const ScrollGaps *g, Rect *r);
+int layout_reveal(Rect c, Rect area, int gap, int startgap, int minw, int minh, int isfloating, int *dx, int *dy);
+int layout_sizehints(Rect *r, Rect cur, Rect bound, int interact, int minsize, const Hints *hints);
+void layout_grid(Rect *r, int n, int pad, int gridw, int gridh, int *totalw, int *totalh);
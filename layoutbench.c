@@ -0,0 +1,407 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * layoutbench checks the invariants of the X-free layout functions in
+ * layout.c and of the window index in winindex.c on random input, then
+ * times them for 1 to 10000 clients. It needs no display. Each benchmark
+ * prints one JSON object per line on stdout; a broken invariant is
+ * reported on stderr and exits 1.
+ *
+ * usage: layoutbench [-s seed]
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "layout.h"
+#include "util.h"
+#include "winindex.h"
+
+#define CHECK(cond, ...) do { if (!(cond)) fail(__LINE__, __VA_ARGS__); } while (0)
+
+static const Rect area = { 0, 24, 2560, 1416 };
+static const ScrollGaps gaps = { 4, 4, 24 };
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+static volatile int sink;
+
+static void
+fail(int line, const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "layoutbench:%d: ", line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+static unsigned int
+rnd(unsigned int n)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	return n ? rng % n : 0;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* mfact in setmfact's 0.05 steps, one in ten floating */
+static void
+genclients(LayoutClient *c, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		c[i].mfact = (1 + rnd(19)) * 0.05f;
+		c[i].isfloating = rnd(10) == 0;
+		c[i].isfullscreen = c[i].isfloating && rnd(20) == 0;
+		c[i].floatx = rnd(n * 800 + 1);
+		c[i].floaty = area.y + rnd(area.h);
+		c[i].w = 50 + rnd(1500);
+		c[i].h = 50 + rnd(1000);
+	}
+}
+
+static int
+overlap(Rect a, Rect b)
+{
+	return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+static void
+checkscroll(int n)
+{
+	LayoutClient *c = ecalloc(n, sizeof *c);
+	Rect *r = ecalloc(n, sizeof *r), *p = ecalloc(n, sizeof *p);
+	int i, prev = -1, ntiled = 0, scrollx = rnd(n * 400 + 1), d = 1 + rnd(3000);
+
+	genclients(c, n);
+	layout_scroll(c, n, area, scrollx, &gaps, r);
+	layout_scroll(c, n, area, scrollx + d, &gaps, p);
+	for (i = 0; i < n; i++)
+		ntiled += !c[i].isfloating;
+	for (i = 0; i < n; i++) {
+		if (c[i].isfloating) {
+			CHECK(r[i].x == c[i].floatx - scrollx && r[i].y == c[i].floaty
+				&& r[i].w == c[i].w && r[i].h == c[i].h, "scroll: floating client %d moved", i);
+			CHECK(p[i].x == r[i].x - d, "scroll: floating client %d ignores the pan", i);
+			continue;
+		}
+		CHECK(r[i].w >= MIN(100, area.w - 2 * gaps.gap) && r[i].w <= MAX(100, area.w - 2 * gaps.gap),
+			"scroll: client %d width %d out of range", i, r[i].w);
+		CHECK(r[i].y >= area.y && r[i].y + r[i].h <= area.y + area.h,
+			"scroll: client %d leaves the area vertically", i);
+		if (ntiled == 1) {
+			CHECK(!memcmp(&p[i], &r[i], sizeof r[i]), "scroll: single client follows the pan");
+			CHECK(r[i].x >= area.x && r[i].x + r[i].w <= area.x + area.w,
+				"scroll: single client not on screen");
+			continue;
+		}
+		CHECK(p[i].x == r[i].x - d && p[i].w == r[i].w, "scroll: client %d is not pan invariant", i);
+		if (prev < 0)
+			CHECK(r[i].x == area.x - scrollx + gaps.startgap, "scroll: strip does not start at the gap");
+		else
+			CHECK(r[i].x == r[prev].x + r[prev].w + gaps.gap,
+				"scroll: clients %d and %d not one gap apart", prev, i);
+		prev = i;
+	}
+	free(c);
+	free(r);
+	free(p);
+}
+
+static void
+checkreveal(void)
+{
+	Rect c = { (int)rnd(10000) - 5000, area.y + 4 + rnd(area.h / 2), 100 + rnd(area.w - 200), 100 };
+	int minw = 1 + rnd(c.w), dx, dy;
+
+	if (!layout_reveal(c, area, gaps.gap, gaps.startgap, minw, 0, 0, &dx, &dy))
+		return;
+	CHECK(dy == 0, "reveal: tiled client moved vertically");
+	c.x -= dx;
+	CHECK(!layout_reveal(c, area, gaps.gap, gaps.startgap, minw, 0, 0, &dx, &dy),
+		"reveal: still hidden after panning, dx %d", dx);
+}
+
+static void
+checksizehints(void)
+{
+	Hints h = { 0 };
+	Rect r = { (int)rnd(3000) - 500, (int)rnd(2000) - 500, rnd(3000), rnd(2000) }, cur = r, s;
+
+	h.basew = rnd(40);
+	h.baseh = rnd(40);
+	h.minw = h.basew + rnd(100);
+	h.minh = h.baseh + rnd(100);
+	h.incw = rnd(3) ? 0 : 1 + rnd(20);
+	h.inch = rnd(3) ? 0 : 1 + rnd(20);
+	h.maxw = rnd(2) ? 0 : h.minw + rnd(2000);
+	h.maxh = rnd(2) ? 0 : h.minh + rnd(2000);
+	layout_sizehints(&r, cur, area, rnd(2), gaps.minh, &h);
+	CHECK(r.w >= MIN(h.minw, h.maxw ? h.maxw : h.minw) && r.h >= MIN(h.minh, h.maxh ? h.maxh : h.minh),
+		"sizehints: %dx%d below the minimum", r.w, r.h);
+	CHECK((!h.maxw || r.w <= h.maxw) && (!h.maxh || r.h <= h.maxh),
+		"sizehints: %dx%d above the maximum", r.w, r.h);
+	/* a maximum off the increment grid is the one thing a second pass may
+	 * still round down */
+	s = r;
+	layout_sizehints(&s, r, area, 0, gaps.minh, &h);
+	CHECK((h.maxw || s.w == r.w) && (h.maxh || s.h == r.h),
+		"sizehints: applying twice changes %dx%d to %dx%d", r.w, r.h, s.w, s.h);
+
+	cur = (Rect){ 0, 0, 1 + rnd(500), 1 + rnd(500) };
+	r = (Rect){ area.x + area.w + rnd(100), area.y - 5000, rnd(3), rnd(3) };
+	layout_sizehints(&r, cur, area, 0, gaps.minh, NULL);
+	CHECK(r.w >= gaps.minh && r.h >= gaps.minh, "sizehints: smaller than the bar");
+	CHECK(r.x < area.x + area.w && r.y + r.h > area.y, "sizehints: window left unreachable");
+}
+
+static void
+checkgrid(int n)
+{
+	Rect *r = ecalloc(n, sizeof *r);
+	int i, j, tw, th;
+
+	for (i = 0; i < n; i++) {
+		r[i].w = 20 + rnd(300);
+		r[i].h = 20 + rnd(200);
+	}
+	layout_grid(r, n, 8, 1800, 1000, &tw, &th);
+	for (i = 0; i < n; i++) {
+		CHECK(r[i].w <= tw, "grid: box %d wider than the reported width", i);
+		for (j = i + 1; j < n; j++)
+			CHECK(!overlap(r[i], r[j]), "grid: boxes %d and %d overlap", i, j);
+	}
+	free(r);
+}
+
+/* n distinct XIDs as a server hands them out: a client base in the high
+ * bits, a per-client counter below */
+static void
+genwindows(unsigned long *w, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		w[i] = ((unsigned long)(1 + i % 64) << 21) | (1 + i / 64);
+	for (i = n - 1; i > 0; i--) {
+		int j = rnd(i + 1);
+		unsigned long t = w[i];
+
+		w[i] = w[j];
+		w[j] = t;
+	}
+}
+
+/* random adds and deletes against a plain array of what must be present */
+static void
+checkwinindex(int n)
+{
+	WinIndex ix = { 0 };
+	unsigned long *w = ecalloc(n, sizeof *w);
+	int *in = ecalloc(n, sizeof *in);
+	int i, k, count = 0;
+	WinEntry *e;
+
+	genwindows(w, n);
+	for (k = 0; k < 4 * n; k++) {
+		i = rnd(n);
+		if (rnd(3)) {
+			winindexadd(&ix, w[i], i % 5, &w[i]);
+			count += !in[i];
+			in[i] = 1;
+		} else {
+			winindexdel(&ix, w[i]);
+			count -= in[i];
+			in[i] = 0;
+		}
+	}
+	CHECK(ix.count == (unsigned int)count, "winindex: count %u, expected %d", ix.count, count);
+	CHECK(ix.count * 2 <= ix.size, "winindex: load factor above 1/2");
+	for (i = 0; i < n; i++) {
+		e = winindexget(&ix, w[i]);
+		if (in[i])
+			CHECK(e && e->kind == i % 5 && e->p == &w[i], "winindex: window %lx lost", w[i]);
+		else
+			CHECK(!e, "winindex: deleted window %lx still found", w[i]);
+	}
+	CHECK(!winindexget(&ix, 0), "winindex: found None");
+	winindexfree(&ix);
+	free(w);
+	free(in);
+}
+
+static void
+report(const char *name, int n, long iters, double ns)
+{
+	printf("{\"bench\":\"%s\",\"clients\":%d,\"iterations\":%ld,"
+		"\"ns_per_call\":%.1f,\"ns_per_client\":%.2f}\n",
+		name, n, iters, ns / iters, ns / iters / n);
+	fflush(stdout);
+}
+
+static void
+benchscroll(int n)
+{
+	LayoutClient *c = ecalloc(n, sizeof *c);
+	Rect *r = ecalloc(n, sizeof *r);
+	long i, iters = MAX(10, 20000000L / n);
+	double t;
+
+	genclients(c, n);
+	t = now();
+	for (i = 0; i < iters; i++) {
+		layout_scroll(c, n, area, i & 1023, &gaps, r);
+		sink += r[n - 1].x;
+	}
+	report("scroll", n, iters, now() - t);
+	free(c);
+	free(r);
+}
+
+static void
+benchgrid(int n)
+{
+	Rect *r = ecalloc(n, sizeof *r);
+	long i, iters = MAX(10, 5000000L / n);
+	int tw, th, k;
+	double t;
+
+	for (k = 0; k < n; k++) {
+		r[k].w = 20 + rnd(300);
+		r[k].h = 20 + rnd(200);
+	}
+	t = now();
+	for (i = 0; i < iters; i++) {
+		layout_grid(r, n, 8, 1800, 1000, &tw, &th);
+		sink += th;
+	}
+	report("grid", n, iters, now() - t);
+	free(r);
+}
+
+/* what wintoclient() walked before the index: Clients, each allocated on
+ * its own, in a list per monitor and tag; win sits behind the name */
+typedef struct ListClient ListClient;
+struct ListClient {
+	char name[256];
+	unsigned long win;
+	ListClient *next;
+};
+
+#define LISTMONS 2
+#define LISTTAGS 9
+
+/* lookups of present windows in random order, then the same with the
+ * list walk the index replaced */
+static void
+benchwinindex(int n)
+{
+	WinIndex ix = { 0 };
+	unsigned long *w = ecalloc(n, sizeof *w);
+	ListClient *lists[LISTMONS][LISTTAGS] = { { NULL } }, **cs = ecalloc(n, sizeof *cs), *c;
+	long i, iters = 20000000L;
+	int k, m, tag;
+	double t;
+
+	genwindows(w, n);
+	for (k = 0; k < n; k++)
+		winindexadd(&ix, w[k], 0, &w[k]);
+	t = now();
+	for (i = 0; i < iters; i++)
+		sink += winindexget(&ix, w[rnd(n)])->kind;
+	report("winindex", n, iters, now() - t);
+
+	/* allocated in window order, spread over the lists at random as
+	 * clients come and go between tags and monitors */
+	for (k = 0; k < n; k++) {
+		cs[k] = c = ecalloc(1, sizeof *c);
+		c->win = w[k];
+		m = rnd(LISTMONS);
+		tag = rnd(LISTTAGS);
+		c->next = lists[m][tag];
+		lists[m][tag] = c;
+	}
+	iters = MAX(1000, 200000000L / n);
+	t = now();
+	for (i = 0; i < iters; i++) {
+		unsigned long x = w[rnd(n)];
+
+		for (m = 0; m < LISTMONS; m++)
+			for (tag = 0; tag < LISTTAGS; tag++)
+				for (c = lists[m][tag]; c; c = c->next)
+					if (c->win == x)
+						goto found;
+found:
+		sink += c != NULL;
+	}
+	report("winlists", n, iters, now() - t);
+	for (k = 0; k < n; k++)
+		free(cs[k]);
+	free(cs);
+	winindexfree(&ix);
+	free(w);
+}
+
+static void
+benchsizehints(void)
+{
+	Hints h = { 10, 20, 7, 13, 0, 0, 10, 20, 0.5f, 2.0f };
+	Rect r, cur = { 100, 100, 800, 600 };
+	long i, iters = 10000000L;
+	double t;
+
+	t = now();
+	for (i = 0; i < iters; i++) {
+		r = (Rect){ 100 + (i & 255), 100, 800 + (i & 511), 600 };
+		sink += layout_sizehints(&r, cur, area, 0, gaps.minh, &h) + r.w;
+	}
+	report("sizehints", 1, iters, now() - t);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const int sizes[] = { 1, 10, 100, 1000, 10000 };
+	static const int winsizes[] = { 10, 100, 1000, 5000 };
+	unsigned int i;
+	int round;
+
+	if (argc == 3 && !strcmp(argv[1], "-s"))
+		rng = strtoull(argv[2], NULL, 0) | 1;
+	else if (argc != 1)
+		die("usage: layoutbench [-s seed]");
+
+	for (round = 0; round < 2000; round++) {
+		checkscroll(1 + rnd(round < 1000 ? 4 : 200));
+		checkreveal();
+		checksizehints();
+		if (round % 10 == 0) {
+			checkgrid(1 + rnd(120));
+			checkwinindex(1 + rnd(round < 1000 ? 20 : 3000));
+		}
+	}
+
+	for (i = 0; i < LENGTH(sizes); i++)
+		benchscroll(sizes[i]);
+	for (i = 0; i < LENGTH(sizes); i++)
+		if (sizes[i] <= 1000)
+			benchgrid(sizes[i]);
+	benchsizehints();
+	for (i = 0; i < LENGTH(winsizes); i++)
+		benchwinindex(winsizes[i]);
+	return 0;
+}
@@ -1,42 +1,421 @@
-/* cc transient.c -o transient -lX11 */
-
+/* cc transient.c -o transient -lX11 -lXdamage -lXfixes
+ *
+ * Client churn load generator for dwm. It keeps up to -n windows alive and
+ * creates, retitles, resizes, marks urgent, toggles fullscreen on and
+ * destroys them at the given rates. Windows are a mix of normal, dialog,
+ * transient and fixed-size ones. Once a second it prints a JSON line saying
+ * how far dwm lags behind:
+ *   map     XMapWindow to the MapNotify dwm's manage() produces
+ *   rename  title change of the focused window to the next redraw of a
+ *           bar's tab area (via XDamage), sampled only while no other
+ *           operation has a bar redraw outstanding
+ * and how many ConfigureNotify events its windows got from the server
+ * (real) and from dwm (synthetic). ICCCM 4.1.5 wants one real event for a
+ * resize, a real and a synthetic one for a move, a synthetic one when the
+ * window only rides along with a pan.
+ *
+ * usage: transient [-n windows] [-c creates/s] [-u term|browser|renames/s]
+ *                  [-z resizes/s] [-g urgent/s] [-f fullscreen/s]
+ *                  [-m normal,dialog,transient,fixed] [-t seconds]
+ *
+ * -m takes the four weights of the window kinds, e.g. -m 70,10,10,10.
+ */
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <X11/Xatom.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/Xdamage.h>
+
+enum { Normal, Dialog, Transient, Fixed, KindLast };
+enum { OpCreate, OpRename, OpResize, OpUrgent, OpFullscreen, OpLast };
+
+typedef struct {
+	Window win;
+	int kind;
+	int fullscreen, urgent;
+	double mapsent; /* 0 once mapped */
+} Win;
+
+typedef struct {
+	double *v;
+	int n, cap;
+} Series;
+
+static Display *dpy;
+static Window root;
+static int sw, sh;
+static Win *wins;
+static int nwins, maxwins = 200;
+static int mix[KindLast] = { 70, 10, 10, 10 };
+static double rate[OpLast] = { 50, 0, 10, 2, 1 }; /* per second */
+static double renamehz = 2; /* per window and second */
+static Atom netwmname, utf8, netstate, netfs, nettype, nettypedialog, netactive;
+static Window active; /* dwm only redraws the bar for the focused client's title */
+static int damageevent = -1;
+static int nbars;
+static double renamesent; /* oldest rename not yet on a bar, 0 if none */
+static int otherpending;  /* an operation that redraws the bar, not drawn yet */
+static Series maplag, renamelag, allmap, allrename;
+static unsigned long ops;
+static unsigned long configures[2], allconfigures[2]; /* real, synthetic */
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "transient: %s\n", msg);
+	exit(1);
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+push(Series *s, double v)
+{
+	if (s->n == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 256;
+		if (!(s->v = realloc(s->v, s->cap * sizeof *s->v)))
+			die("out of memory");
+	}
+	s->v[s->n++] = v;
+}
+
+static int
+cmpdouble(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void
+printseries(const char *name, Series *s)
+{
+	double p50 = -1, p99 = -1, max = -1;
+
+	if (s->n) {
+		qsort(s->v, s->n, sizeof *s->v, cmpdouble);
+		p50 = s->v[(s->n - 1) / 2];
+		p99 = s->v[(s->n * 99 + 99) / 100 - 1];
+		max = s->v[s->n - 1];
+	}
+	printf(",\"%s_n\":%d,\"%s_p50_us\":%.1f,\"%s_p99_us\":%.1f,\"%s_max_us\":%.1f",
+		name, s->n, name, p50, name, p99, name, max);
+}
+
+/* one line for the last second, or for the whole run when total is set */
+static void
+report(double t, int total)
+{
+	printf("{\"%s\":%.1f,\"windows\":%d,\"ops\":%lu", total ? "total" : "t", t, nwins, ops);
+	printseries("map", total ? &allmap : &maplag);
+	printseries("rename", total ? &allrename : &renamelag);
+	printf(",\"configure_real\":%lu,\"configure_synthetic\":%lu}\n",
+		total ? allconfigures[0] : configures[0], total ? allconfigures[1] : configures[1]);
+	fflush(stdout);
+	maplag.n = renamelag.n = 0;
+	ops = configures[0] = configures[1] = 0;
+}
+
+static int
+pick(void)
+{
+	return nwins ? rand() % nwins : -1;
+}
+
+static void
+settitle(Win *w)
+{
+	char name[64];
+	int n;
+
+	n = snprintf(name, sizeof name, "churn %lx %d", w->win, rand());
+	XChangeProperty(dpy, w->win, netwmname, utf8, 8, PropModeReplace, (unsigned char *)name, n);
+	XStoreName(dpy, w->win, name);
+}
+
+static void
+sendstate(Win *w, int on)
+{
+	XEvent ev = { 0 };
+
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = w->win;
+	ev.xclient.message_type = netstate;
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = on; /* _NET_WM_STATE_ADD or _REMOVE */
+	ev.xclient.data.l[1] = netfs;
+	XSendEvent(dpy, root, False, SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+}
+
+static void
+destroy(int i)
+{
+	XDestroyWindow(dpy, wins[i].win);
+	wins[i] = wins[--nwins];
+}
+
+static void
+create(void)
+{
+	int i, k, r = rand() % (mix[0] + mix[1] + mix[2] + mix[3]);
+	XSizeHints hints;
+	Win *w;
+
+	if (nwins == maxwins)
+		destroy(pick());
+	for (k = 0; k < KindLast - 1 && r >= mix[k]; k++)
+		r -= mix[k];
+	w = &wins[nwins];
+	memset(w, 0, sizeof *w);
+	w->kind = k;
+	/* full height keeps normal windows tiled */
+	w->win = XCreateSimpleWindow(dpy, root, 0, 0, sw / 4 + rand() % (sw / 4), k == Normal ? sh : sh / 2, 0, 0, 0);
+	XSelectInput(dpy, w->win, StructureNotifyMask);
+	settitle(w);
+	switch (k) {
+	case Dialog:
+		XChangeProperty(dpy, w->win, nettype, XA_ATOM, 32, PropModeReplace,
+			(unsigned char *)&nettypedialog, 1);
+		break;
+	case Transient:
+		for (i = 0; i < nwins && wins[i].kind != Normal; i++);
+		if (i < nwins)
+			XSetTransientForHint(dpy, w->win, wins[i].win);
+		break;
+	case Fixed:
+		hints.flags = PMinSize | PMaxSize;
+		hints.min_width = hints.max_width = sw / 4;
+		hints.min_height = hints.max_height = sh / 3;
+		XSetWMNormalHints(dpy, w->win, &hints);
+		break;
+	}
+	nwins++;
+	w->mapsent = now();
+	XMapWindow(dpy, w->win);
+}
+
+static void
+doop(int op)
+{
+	XWMHints *wmh;
+	int i;
 
-int main(void) {
-	Display *d;
-	Window r, f, t = None;
-	XSizeHints h;
-	XEvent e;
-
-	d = XOpenDisplay(NULL);
-	if (!d)
-		exit(1);
-	r = DefaultRootWindow(d);
-
-	f = XCreateSimpleWindow(d, r, 100, 100, 400, 400, 0, 0, 0);
-	h.min_width = h.max_width = h.min_height = h.max_height = 400;
-	h.flags = PMinSize | PMaxSize;
-	XSetWMNormalHints(d, f, &h);
-	XStoreName(d, f, "floating");
-	XMapWindow(d, f);
-
-	XSelectInput(d, f, ExposureMask);
-	while (1) {
-		XNextEvent(d, &e);
-
-		if (t == None) {
-			sleep(5);
-			t = XCreateSimpleWindow(d, r, 50, 50, 100, 100, 0, 0, 0);
-			XSetTransientForHint(d, t, f);
-			XStoreName(d, t, "transient");
-			XMapWindow(d, t);
-			XSelectInput(d, t, ExposureMask);
+	ops++;
+	/* maps, focus, urgency and fullscreen redraw the tabs as well, so a
+	 * damage after them says nothing about the rename */
+	if (op != OpRename) {
+		otherpending = 1;
+		renamesent = 0;
+	}
+	if (op == OpCreate) {
+		create();
+		return;
+	}
+	if ((i = pick()) < 0)
+		return;
+	switch (op) {
+	case OpRename:
+		settitle(&wins[i]);
+		if (wins[i].win == active && !renamesent && !otherpending)
+			renamesent = now();
+		break;
+	case OpResize:
+		XResizeWindow(dpy, wins[i].win, sw / 4 + rand() % (sw / 4), sh / 2 + rand() % (sh / 2));
+		break;
+	case OpUrgent:
+		if (!(wmh = XGetWMHints(dpy, wins[i].win)) && !(wmh = XAllocWMHints()))
+			break;
+		wins[i].urgent = !wins[i].urgent;
+		wmh->flags = wins[i].urgent ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
+		XSetWMHints(dpy, wins[i].win, wmh);
+		XFree(wmh);
+		break;
+	case OpFullscreen:
+		wins[i].fullscreen = !wins[i].fullscreen;
+		sendstate(&wins[i], wins[i].fullscreen);
+		break;
+	}
+}
+
+/* dwm's bars are the root children with WM_CLASS "dwm" */
+static void
+findbars(void)
+{
+	Window r, p, *kids = NULL;
+	unsigned int i, n;
+	XClassHint ch;
+
+	if (!XQueryTree(dpy, root, &r, &p, &kids, &n))
+		return;
+	for (i = 0; i < n; i++) {
+		if (!XGetClassHint(dpy, kids[i], &ch))
+			continue;
+		if (ch.res_class && !strcmp(ch.res_class, "dwm")) {
+			XDamageCreate(dpy, kids[i], XDamageReportNonEmpty);
+			nbars++;
 		}
+		XFree(ch.res_name);
+		XFree(ch.res_class);
 	}
+	XFree(kids);
+}
 
-	XCloseDisplay(d);
-	exit(0);
+static void
+handle(XEvent *ev)
+{
+	XDamageNotifyEvent *de;
+	unsigned char *p = NULL;
+	unsigned long n, after;
+	Atom type;
+	int i, format;
+
+	if (ev->type == PropertyNotify && ev->xproperty.atom == netactive) {
+		active = None;
+		if (XGetWindowProperty(dpy, root, netactive, 0, 1, False, XA_WINDOW,
+		                       &type, &format, &n, &after, &p) == Success && p) {
+			if (n)
+				active = *(Window *)p;
+			XFree(p);
+		}
+	} else if (ev->type == MapNotify) {
+		for (i = 0; i < nwins; i++)
+			if (wins[i].win == ev->xmap.window && wins[i].mapsent) {
+				push(&maplag, now() - wins[i].mapsent);
+				push(&allmap, now() - wins[i].mapsent);
+				wins[i].mapsent = 0;
+			}
+	} else if (ev->type == ConfigureNotify) {
+		/* the root's own and other clients' notifies are not selected */
+		configures[!!ev->xconfigure.send_event]++;
+		allconfigures[!!ev->xconfigure.send_event]++;
+	} else if (damageevent >= 0 && ev->type == damageevent + XDamageNotify) {
+		de = (XDamageNotifyEvent *)ev;
+		XDamageSubtract(dpy, de->damage, None, None);
+		/* the tabs are drawn from x 0, the status widgets further right */
+		if (de->area.x != 0)
+			return;
+		if (renamesent) {
+			push(&renamelag, now() - renamesent);
+			push(&allrename, now() - renamesent);
+			renamesent = 0;
+		}
+		otherpending = 0;
+	}
+}
+
+static double
+parserate(const char *s)
+{
+	if (!strcmp(s, "term"))
+		return 10;   /* prompts and running commands retitle often */
+	if (!strcmp(s, "browser"))
+		return 0.5;  /* page loads and tab switches */
+	return atof(s);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct pollfd pfd;
+	double next[OpLast], start, t, lastreport, duration = 0, r;
+	int i, op, timeout, err;
+	XEvent ev;
+
+	for (i = 1; i + 1 < argc; i += 2) {
+		if (!strcmp(argv[i], "-n"))
+			maxwins = atoi(argv[i + 1]);
+		else if (!strcmp(argv[i], "-c"))
+			rate[OpCreate] = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-u"))
+			renamehz = parserate(argv[i + 1]);
+		else if (!strcmp(argv[i], "-z"))
+			rate[OpResize] = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-g"))
+			rate[OpUrgent] = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-f"))
+			rate[OpFullscreen] = atof(argv[i + 1]);
+		else if (!strcmp(argv[i], "-t"))
+			duration = atof(argv[i + 1]) * 1e6;
+		else if (!strcmp(argv[i], "-m")) {
+			if (sscanf(argv[i + 1], "%d,%d,%d,%d", &mix[0], &mix[1], &mix[2], &mix[3]) != 4)
+				die("-m wants four weights: normal,dialog,transient,fixed");
+		} else
+			break;
+	}
+	if (i < argc || maxwins < 1 || mix[0] + mix[1] + mix[2] + mix[3] <= 0)
+		die("usage: transient [-n windows] [-c creates/s] [-u term|browser|renames/s] "
+		    "[-z resizes/s] [-g urgent/s] [-f fullscreen/s] "
+		    "[-m normal,dialog,transient,fixed] [-t seconds]");
+	if (!(dpy = XOpenDisplay(NULL)))
+		die("cannot open display");
+	if (!(wins = calloc(maxwins, sizeof *wins)))
+		die("out of memory");
+	root = DefaultRootWindow(dpy);
+	sw = DisplayWidth(dpy, DefaultScreen(dpy));
+	sh = DisplayHeight(dpy, DefaultScreen(dpy));
+	netwmname = XInternAtom(dpy, "_NET_WM_NAME", False);
+	utf8 = XInternAtom(dpy, "UTF8_STRING", False);
+	netstate = XInternAtom(dpy, "_NET_WM_STATE", False);
+	netfs = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
+	nettype = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
+	nettypedialog = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
+	netactive = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+	XSelectInput(dpy, root, PropertyChangeMask);
+	if (XDamageQueryExtension(dpy, &damageevent, &err))
+		findbars();
+	else
+		damageevent = -1;
+	if (!nbars)
+		fprintf(stderr, "transient: no dwm bar found, rename lag is not measured\n");
+
+	srand(time(NULL));
+	start = lastreport = now();
+	for (op = 0; op < OpLast; op++)
+		next[op] = start;
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+	for (;;) {
+		t = now();
+		if (duration && t - start >= duration)
+			break;
+		rate[OpRename] = renamehz * nwins;
+		for (op = 0; op < OpLast; op++)
+			for (; rate[op] > 0 && next[op] <= t; next[op] += 1e6 / rate[op])
+				doop(op);
+		if (t - lastreport >= 1e6) {
+			report((t - start) / 1e6, 0);
+			lastreport = t;
+		}
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			handle(&ev);
+		}
+		/* sleep until the next scheduled operation */
+		r = lastreport + 1e6;
+		for (op = 0; op < OpLast; op++)
+			if (rate[op] > 0 && next[op] < r)
+				r = next[op];
+		timeout = r > t ? (r - t) / 1e3 : 0;
+		poll(&pfd, 1, timeout);
+		/* catch up by at most a second when dwm stalls us */
+		for (op = 0; op < OpLast; op++)
+			if (next[op] < now() - 1e6)
+				next[op] = now();
+	}
+	report((now() - start) / 1e6, 1);
+	while (nwins)
+		destroy(nwins - 1);
+	XCloseDisplay(dpy);
+	return 0;
 }
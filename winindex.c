@@ -0,0 +1,96 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "winindex.h"
+#include "util.h"
+
+static unsigned int
+winhash(const WinIndex *ix, unsigned long w)
+{
+	/* XIDs share the client base in the high bits, so mix before masking;
+	 * the fold brings the well mixed top half down to the mask */
+	uint64_t h = (uint64_t)w * 0x9E3779B97F4A7C15ULL;
+
+	return (unsigned int)(h ^ h >> 32) & (ix->size - 1);
+}
+
+static void
+winindexgrow(WinIndex *ix)
+{
+	WinEntry *old = ix->tab;
+	unsigned int i, oldsize = ix->size;
+
+	ix->size = oldsize ? oldsize * 2 : 64;
+	ix->tab = ecalloc(ix->size, sizeof(WinEntry));
+	ix->count = 0;
+	for (i = 0; i < oldsize; i++)
+		if (old[i].win)
+			winindexadd(ix, old[i].win, old[i].kind, old[i].p);
+	free(old);
+}
+
+void
+winindexadd(WinIndex *ix, unsigned long w, int kind, void *p)
+{
+	unsigned int i;
+
+	if (!w)
+		return;
+	/* keep the load factor at or below 1/2 so probe chains stay short */
+	if ((ix->count + 1) * 2 > ix->size)
+		winindexgrow(ix);
+	for (i = winhash(ix, w); ix->tab[i].win && ix->tab[i].win != w; i = (i + 1) & (ix->size - 1));
+	if (!ix->tab[i].win)
+		ix->count++;
+	ix->tab[i].win = w;
+	ix->tab[i].kind = kind;
+	ix->tab[i].p = p;
+}
+
+void
+winindexdel(WinIndex *ix, unsigned long w)
+{
+	unsigned int i, j, k;
+
+	if (!w || !ix->size)
+		return;
+	for (i = winhash(ix, w); ix->tab[i].win && ix->tab[i].win != w; i = (i + 1) & (ix->size - 1));
+	if (!ix->tab[i].win)
+		return;
+	/* backward-shift deletion: pull later members of the chain into the hole */
+	for (j = i;;) {
+		ix->tab[i].win = 0;
+		do {
+			j = (j + 1) & (ix->size - 1);
+			if (!ix->tab[j].win) {
+				ix->count--;
+				return;
+			}
+			k = winhash(ix, ix->tab[j].win);
+		} while (i <= j ? (i < k && k <= j) : (i < k || k <= j));
+		ix->tab[i] = ix->tab[j];
+		i = j;
+	}
+}
+
+WinEntry *
+winindexget(const WinIndex *ix, unsigned long w)
+{
+	unsigned int i;
+
+	if (!w || !ix->size)
+		return NULL;
+	for (i = winhash(ix, w); ix->tab[i].win; i = (i + 1) & (ix->size - 1))
+		if (ix->tab[i].win == w)
+			return &ix->tab[i];
+	return NULL;
+}
+
+void
+winindexfree(WinIndex *ix)
+{
+	free(ix->tab);
+	ix->tab = NULL;
+	ix->size = ix->count = 0;
+}
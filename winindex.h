@@ -0,0 +1,23 @@
+/* See LICENSE file for copyright and license details. */
+
+/* Window-keyed index: nothing here talks to the X server, so layoutbench
+ * can run it without a display. Keys are XIDs, 0 (None) is never stored. */
+
+/* maps an X window to the object dwm owns for it, kind says which */
+typedef struct {
+	unsigned long win;
+	int kind;
+	void *p;
+} WinEntry;
+
+/* open addressing with linear probing, load factor at most 1/2 */
+typedef struct {
+	WinEntry *tab;
+	unsigned int size;  /* slots, always a power of two */
+	unsigned int count;
+} WinIndex;
+
+void winindexadd(WinIndex *ix, unsigned long w, int kind, void *p);
+void winindexdel(WinIndex *ix, unsigned long w);
+WinEntry *winindexget(const WinIndex *ix, unsigned long w);
+void winindexfree(WinIndex *ix);